@@ -5,19 +5,90 @@ layout(location = 0) out vec4 color;
 in vec3 view_pos;
 in vec3 view_pos_normal;
 
-uniform vec3 light_pos[3];
-uniform vec3 light_col[3]; // light color
-uniform int light_toggled[3]; // light on/off
-uniform vec3 light_brightness; // light brightness
+struct PointLight
+{
+	vec4 position_radius; // view space position, a radius of 0 reaches everything
+	vec4 color_brightness;
+};
+
+layout(std430, binding = 0) readonly buffer LightData
+{
+	PointLight lights[];
+};
+
+layout(std140, binding = 1) uniform Lights
+{
+	uvec4 cluster_grid; // tiles along x and y, depth slices, number of lights
+	vec4 cluster_params; // viewport width and height, near and far planes
+	uvec4 light_counts; // lights reaching everything, they come first in lights[] and are in no cluster, then 1 without clustering
+};
+
+layout(std430, binding = 1) readonly buffer ClusterData
+{
+	uvec2 clusters[]; // first entry in light_indices and number of lights
+};
+
+layout(std430, binding = 2) readonly buffer LightIndexData
+{
+	uint light_indices[];
+};
+
+layout(std140, binding = 2) uniform Material
+{
+	vec3 ambient; // ambient constant
+	float shine; // phong exponent
+	vec3 diffuse; // diffuse constant
+	float metallic; // metallic constant, Cook-Torrance only
+	vec3 specular; // specular constant
+	float roughness; // roughness constant, Cook-Torrance only
+	vec3 warm; // Gooch only
+	float alpha;
+	vec3 cool;
+	float beta;
+};
 
-uniform vec3 ambient; // ambient constant
-uniform vec3 diffuse; // diffuse constant
-uniform vec3 specular; // specular constnat
-uniform float shine; // phong exponent
+// permutation switches, defined by the application to specialize the program,
+// left undefined they fall back to the runtime values
+#ifndef FLAT_SHADING
+uniform int flat_shading; // face normals from screen space derivatives
+#define FLAT_SHADING flat_shading
+#endif
+#ifndef GLOBAL_LIGHTS
+#define GLOBAL_LIGHTS light_counts.x // lights reaching everything, a constant count unrolls their loop
+#endif
+#ifndef CLUSTER_LIGHTS
+#define CLUSTER_LIGHTS 1 // 0 when no light has a radius, the cluster lookup goes away
+#endif
 
-vec3 compute_light(vec3 lightpos, vec3 lightcol)
+vec3 surface_normal()
+{
+	// the position derivatives span the triangle, so their cross product is the face normal
+	if (FLAT_SHADING == 1)
+		return normalize(cross(dFdx(view_pos), dFdy(view_pos)));
+	return normalize(view_pos_normal);
+}
+
+// cluster of the fragment: its screen tile and exponential depth slice
+uint cluster_index()
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / cluster_params.xy * vec2(cluster_grid.xy)), cluster_grid.xy - 1u);
+	float depth = max(-view_pos.z, cluster_params.z);
+	uint slice = min(uint(log(depth / cluster_params.z) / log(cluster_params.w / cluster_params.z) * float(cluster_grid.z)), cluster_grid.z - 1u);
+	return tile.x + cluster_grid.x * (tile.y + cluster_grid.y * slice);
+}
+
+// smooth window reaching 0 at the light radius
+float light_falloff(vec4 position_radius)
+{
+	if (position_radius.w <= 0.0)
+		return 1.0;
+	float ratio = length(position_radius.xyz - view_pos) / position_radius.w;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window;
+}
+
+vec3 compute_light(vec3 n, vec3 lightpos, vec3 lightcol)
 {
-	vec3 n = normalize(view_pos_normal);
 	vec3 v = normalize(-view_pos);
 	vec3 l = normalize(lightpos - view_pos);
 	vec3 h = normalize(v + l);
@@ -31,11 +102,24 @@ vec3 compute_light(vec3 lightpos, vec3 lightcol)
 
 void main()
 {
+	// the normal is taken before the loop, derivatives need uniform control flow
+	vec3 n = surface_normal();
 	vec3 total_light = ambient * 0.2;
-	for (int i = 0; i < 3; i++)
-    {
-		if (light_toggled[i] == 1)
-			total_light += compute_light(light_pos[i], light_col[i]) * light_brightness[i];
-    }
+
+	for (uint i = 0u; i < uint(GLOBAL_LIGHTS); i++)
+	{
+		total_light += compute_light(n, lights[i].position_radius.xyz, lights[i].color_brightness.rgb) * lights[i].color_brightness.a;
+	}
+
+#if CLUSTER_LIGHTS
+	// without clustering every light with a radius is read straight from lights[]
+	bool unclustered = light_counts.y != 0u;
+	uvec2 cluster = unclustered ? uvec2(uint(GLOBAL_LIGHTS), cluster_grid.w - uint(GLOBAL_LIGHTS)) : clusters[cluster_index()];
+	for (uint i = 0u; i < cluster.y; i++)
+	{
+		PointLight light = lights[unclustered ? cluster.x + i : light_indices[cluster.x + i]];
+		total_light += compute_light(n, light.position_radius.xyz, light.color_brightness.rgb) * light.color_brightness.a * light_falloff(light.position_radius);
+	}
+#endif
 	color = vec4(total_light, 1.0);
 };
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 460 core
+
+// depth only, color writes are masked during the pre-pass
+void main()
+{
+};
@@ -0,0 +1,20 @@
+#version 460 core
+
+layout(location = 0) in vec3 position;
+
+layout(std140, binding = 0) uniform Transforms
+{
+    mat4 u_Model;
+    mat4 u_View;
+    mat4 u_Projection;
+    mat4 u_Normal; // transpose(inverse(u_Model)), normals use its upper 3x3
+};
+
+// the lit pass tests against this depth with GL_EQUAL, both must compute the exact same position
+invariant gl_Position;
+
+void main()
+{
+    vec4 view_pos4 = u_View * u_Model * vec4(position, 1.0);
+    gl_Position = u_Projection * view_pos4;
+};
@@ -3,8 +3,81 @@
 layout(location = 0) out vec4 color;
 
 in vec3 total_color;
+in vec3 frag_view_pos;
+
+// defined by the application to specialize the program, the runtime uniform otherwise
+#ifndef FLAT_SHADING
+uniform int flat_shading; // face normals from screen space derivatives
+#define FLAT_SHADING flat_shading
+#endif
+
+struct PointLight
+{
+	vec4 position_radius; // view space position, a radius of 0 reaches everything
+	vec4 color_brightness;
+};
+
+layout(std430, binding = 0) readonly buffer LightData
+{
+	PointLight lights[];
+};
+
+layout(std140, binding = 1) uniform Lights
+{
+	uvec4 cluster_grid; // tiles along x and y, depth slices, number of lights
+	vec4 cluster_params; // viewport width and height, near and far planes
+	uvec4 light_counts; // lights reaching everything, they come first in lights[] and are in no cluster, then 1 without clustering
+};
+
+layout(std140, binding = 2) uniform Material
+{
+	vec3 ambient; // ambient constant
+	float shine; // phong exponent
+	vec3 diffuse; // diffuse constant
+	float metallic; // metallic constant, Cook-Torrance only
+	vec3 specular; // specular constant
+	float roughness; // roughness constant, Cook-Torrance only
+	vec3 warm; // Gooch only
+	float alpha;
+	vec3 cool;
+	float beta;
+};
+
+// smooth window reaching 0 at the light radius
+float light_falloff(vec4 position_radius)
+{
+	if (position_radius.w <= 0.0)
+		return 1.0;
+	float ratio = length(position_radius.xyz - frag_view_pos) / position_radius.w;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	return window * window;
+}
+
+// vertices are shared between faces in flat shading, so the face lighting is evaluated here instead
+vec3 compute_face_light(vec3 n, vec3 lightpos, vec3 lightcol)
+{
+	vec3 v = normalize(-frag_view_pos);
+	vec3 l = normalize(lightpos - frag_view_pos);
+	vec3 r = reflect(-l, n);
+
+	vec3 diffuse_light = diffuse * lightcol * max(0.0, dot(n, l));
+	vec3 spec_light = specular * lightcol * pow(max(0, dot(r, v)), shine/4.0);
+	return diffuse_light + spec_light;
+}
 
 void main()
 {
+	if (FLAT_SHADING == 1)
+	{
+		vec3 n = normalize(cross(dFdx(frag_view_pos), dFdy(frag_view_pos)));
+		vec3 face_color = ambient * 0.2;
+		for (uint i = 0u; i < cluster_grid.w; i++)
+		{
+			face_color += compute_face_light(n, lights[i].position_radius.xyz, lights[i].color_brightness.rgb) * lights[i].color_brightness.a * light_falloff(lights[i].position_radius);
+		}
+		color = vec4(face_color, 1.0);
+		return;
+	}
+
 	color = vec4(total_color, 1.0);
 };
\ No newline at end of file
@@ -4,23 +4,60 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 
 out vec3 total_color;
+out vec3 frag_view_pos;
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+layout(std140, binding = 0) uniform Transforms
+{
+    mat4 u_Model;
+    mat4 u_View;
+    mat4 u_Projection;
+    mat4 u_Normal; // transpose(inverse(u_Model)), normals use its upper 3x3
+};
 
 vec3 view_pos;
 vec3 view_pos_normal;
 
-uniform vec3 light_pos[3];
-uniform vec3 light_col[3]; // light color
-uniform int light_toggled[3]; // light on/off
-uniform vec3 light_brightness; // light brightness
+struct PointLight
+{
+    vec4 position_radius; // view space position, a radius of 0 reaches everything
+    vec4 color_brightness;
+};
+
+layout(std430, binding = 0) readonly buffer LightData
+{
+    PointLight lights[];
+};
 
-uniform vec3 ambient; // ambient constant
-uniform vec3 diffuse; // diffuse constant
-uniform vec3 specular; // specular constant
-uniform float shine; // phong exponent
+layout(std140, binding = 1) uniform Lights
+{
+    uvec4 cluster_grid; // tiles along x and y, depth slices, number of lights
+    vec4 cluster_params; // viewport width and height, near and far planes
+    uvec4 light_counts; // lights reaching everything, they come first in lights[] and are in no cluster, then 1 without clustering
+};
+
+layout(std140, binding = 2) uniform Material
+{
+    vec3 ambient; // ambient constant
+    float shine; // phong exponent
+    vec3 diffuse; // diffuse constant
+    float metallic; // metallic constant, Cook-Torrance only
+    vec3 specular; // specular constant
+    float roughness; // roughness constant, Cook-Torrance only
+    vec3 warm; // Gooch only
+    float alpha;
+    vec3 cool;
+    float beta;
+};
+
+// smooth window reaching 0 at the light radius
+float light_falloff(vec4 position_radius)
+{
+    if (position_radius.w <= 0.0)
+        return 1.0;
+    float ratio = length(position_radius.xyz - view_pos) / position_radius.w;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
 
 vec3 compute_light(vec3 lightpos, vec3 lightcol)
 {
@@ -34,20 +71,24 @@ vec3 compute_light(vec3 lightpos, vec3 lightcol)
     return diffuse_light + spec_light;
 }
 
+// matches the depth pre-pass bit for bit
+invariant gl_Position;
+
 void main()
 {
     vec4 view_pos4 = u_View * u_Model * vec4(position, 1.0);
     view_pos = view_pos4.xyz / view_pos4.w;
+    frag_view_pos = view_pos;
 
-    mat3 normalmatrix = transpose(inverse(mat3(u_Model)));
+    mat3 normalmatrix = mat3(u_Normal);
     view_pos_normal = normalmatrix * normal;
 
     gl_Position = u_Projection * view_pos4;
 
     total_color = ambient * 0.2;
-    for (int i = 0; i < 3; i++)
+    // vertices have no cluster, they go through every light
+    for (uint i = 0u; i < cluster_grid.w; i++)
     {
-        if (light_toggled[i] == 1)
-            total_color += compute_light(light_pos[i], light_col[i]) * light_brightness[i];
+        total_color += compute_light(lights[i].position_radius.xyz, lights[i].color_brightness.rgb) * lights[i].color_brightness.a * light_falloff(lights[i].position_radius);
     }
 };
\ No newline at end of file
@@ -3,11 +3,23 @@
 layout(location = 0) out vec4 color;
 
 in vec3 normal_vec;
+in vec3 object_pos;
+
+// defined by the application to specialize the program, the runtime uniform otherwise
+#ifndef FLAT_SHADING
+uniform int flat_shading; // face normals from screen space derivatives
+#define FLAT_SHADING flat_shading
+#endif
 
 void main()
 {
+	// face normal in object space, as the interpolated vertex normal is
+	vec3 normal_vec_shaded = normal_vec;
+	if (FLAT_SHADING == 1)
+		normal_vec_shaded = normalize(cross(dFdx(object_pos), dFdy(object_pos)));
+
 	// normal vector can have components ranging from -1 to 1, normalize to 0 to 1 for colors
-	vec3 normal = normal_vec / 2;
+	vec3 normal = normal_vec_shaded / 2;
 	normal += (0.5, 0.5, 0.5);
 
 	color = vec4(normal, 1.0);
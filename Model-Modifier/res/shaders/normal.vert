@@ -4,14 +4,24 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 normal;
 
 out vec3 normal_vec;
+out vec3 object_pos;
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+layout(std140, binding = 0) uniform Transforms
+{
+    mat4 u_Model;
+    mat4 u_View;
+    mat4 u_Projection;
+    mat4 u_Normal; // transpose(inverse(u_Model)), normals use its upper 3x3
+};
+
+// matches the depth pre-pass bit for bit
+invariant gl_Position;
 
 void main()
 {
     normal_vec = normal;
+    object_pos = position;
 
-    gl_Position = u_Projection * u_View * u_Model * vec4(position, 1.0f);
+    vec4 view_pos4 = u_View * u_Model * vec4(position, 1.0);
+    gl_Position = u_Projection * view_pos4;
 };
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 460 core
+
+layout(location = 0) out vec4 color;
+
+// every fragment passing the depth test adds one step, brighter pixels were shaded more often
+void main()
+{
+	color = vec4(0.1, 0.05, 0.02, 1.0);
+};
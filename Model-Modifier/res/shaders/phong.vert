@@ -7,16 +7,23 @@ out vec3 pos;
 out vec3 view_pos;
 out vec3 view_pos_normal;
 
-uniform mat4 u_Model;
-uniform mat4 u_View;
-uniform mat4 u_Projection;
+layout(std140, binding = 0) uniform Transforms
+{
+    mat4 u_Model;
+    mat4 u_View;
+    mat4 u_Projection;
+    mat4 u_Normal; // transpose(inverse(u_Model)), normals use its upper 3x3
+};
+
+// matches the depth pre-pass bit for bit
+invariant gl_Position;
 
 void main()
 {
     vec4 view_pos4 = u_View * u_Model * vec4(position, 1.0);
     view_pos = view_pos4.xyz / view_pos4.w;
 
-    mat3 normalmatrix = transpose(inverse(mat3(u_Model)));
+    mat3 normalmatrix = mat3(u_Normal);
     view_pos_normal = normalmatrix * normal;
 
     gl_Position = u_Projection * view_pos4;
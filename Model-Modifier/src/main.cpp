@@ -1,5 +1,12 @@
 #include <iostream>
 #include <ctime>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -7,7 +14,6 @@
 #include "external/imgui/imgui.h"
 #include "external/imgui/imgui_impl_glfw.h"
 #include "external/imgui/imgui_impl_opengl3.h"
-#include "external/stb/stb_image_write.h"
 
 #include "renderer/Window.h"
 #include "renderer/Input.h"
@@ -16,13 +22,19 @@
 #include "renderer/IndexBuffer.h"
 #include "renderer/Shader.h"
 #include "renderer/Camera.h"
-#include "renderer/SaveImage.h"
+#include "renderer/Query.h"
+#include "renderer/UniformBuffer.h"
+#include "renderer/ScreenCapture.h"
 #include "scene/object/Object.h"
 #include "scene/object/ObjectSelect.h"
 #include "scene/Mesh.h"
+#include "scene/ShadingCache.h"
 #include "scene/Material.h"
-#include "scene/Light.h"
+#include "scene/GeometryJobs.h"
+#include "scene/LightManager.h"
+#include "scene/LODChain.h"
 #include "scene/surface/Surface.h"
+#include "scene/surface/VertexClustering.h"
 
 #include "ImguiSections.h"
 
@@ -35,6 +47,7 @@ enum shaderEnum
     GOOCH,
     CEL,
     COOKTORRANCE,
+    OVERDRAW,
 };
 
 enum renderMode
@@ -44,6 +57,10 @@ enum renderMode
     POINTCLOUD
 };
 
+// projection planes, the light clusters slice the same depth range
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 1000.0f;
+
 static void processKeyboardInput(GLFWwindow* window, Camera& camera, float deltaTime)
 {
     // close the window
@@ -121,8 +138,415 @@ static void processKeyboardInput(GLFWwindow* window, Camera& camera, float delta
     }
 }
 
-int main()
+// ray through the cursor in object space, window coordinates start at the bottom left
+static void cursorRay(double xpos, double ypos, unsigned int width, unsigned int height,
+    const glm::mat4& modelView, const glm::mat4& proj, glm::vec3& origin, glm::vec3& direction)
+{
+    glm::vec4 viewport(0.0f, 0.0f, (float)width, (float)height);
+    float winY = (float)(height - ypos);
+    glm::vec3 nearPoint = glm::unProject(glm::vec3((float)xpos, winY, 0.0f), modelView, proj, viewport);
+    glm::vec3 farPoint = glm::unProject(glm::vec3((float)xpos, winY, 1.0f), modelView, proj, viewport);
+    origin = nearPoint;
+    direction = glm::normalize(farPoint - nearPoint);
+}
+
+// closest vertex to the eye among those within maxDist of the ray, -1 if there is none
+// vertices without faces are not drawn and cannot be picked
+static int pickVertex(const Mesh& mesh, glm::vec3 origin, glm::vec3 direction, float maxDist)
+{
+    int picked = -1;
+    float pickedDepth = std::numeric_limits<float>::max();
+    for (unsigned int i = 0; i < mesh.m_Object.m_VertexPos.size(); i++)
+    {
+        if (mesh.m_VertFaceCounts[i] == 0)
+            continue;
+
+        glm::vec3 toVertex = mesh.m_Object.m_VertexPos[i] - origin;
+        float depth = glm::dot(toVertex, direction);
+        if (depth <= 0.0f || depth >= pickedDepth)
+            continue;
+
+        if (glm::length(toVertex - depth * direction) < maxDist)
+        {
+            picked = static_cast<int>(i);
+            pickedDepth = depth;
+        }
+    }
+    return picked;
+}
+
+// obj without the faces removed by repeating a corner and without the vertices no face uses
+// sourceVertices gets the vertex of obj each kept vertex comes from
+static Object compactObject(const Object& obj, std::vector<unsigned int>& sourceVertices)
+{
+    const unsigned int UNUSED = 0xFFFFFFFF;
+    std::vector<unsigned int> newVertIdx(obj.m_VertexPos.size(), UNUSED);
+
+    Object compacted;
+    compacted.m_Min = obj.m_Min; compacted.m_Max = obj.m_Max;
+    for (const std::vector<unsigned int>& corners : obj.m_TriFaceIndices)
+    {
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+            continue;
+
+        std::vector<unsigned int> face(3);
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            if (newVertIdx[corners[j]] == UNUSED)
+            {
+                newVertIdx[corners[j]] = static_cast<unsigned int>(compacted.m_VertexPos.size());
+                compacted.m_VertexPos.push_back(obj.m_VertexPos[corners[j]]);
+                sourceVertices.push_back(corners[j]);
+            }
+            face[j] = newVertIdx[corners[j]];
+        }
+        compacted.m_TriFaceIndices.push_back(face);
+    }
+    compacted.m_FaceIndices = compacted.m_TriFaceIndices;
+    if (!compacted.m_TriFaceIndices.empty())
+        compacted.m_NumPolygons[3] = static_cast<unsigned int>(compacted.m_TriFaceIndices.size());
+
+    return compacted;
+}
+
+// small rotating arc after the previous widget, while work runs in the background
+static void drawSpinner(float radius)
+{
+    ImGui::SameLine();
+    ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImVec2 center(pos.x + radius, pos.y + ImGui::GetTextLineHeight() / 2.0f);
+    float start = (float)ImGui::GetTime() * 8.0f;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PathArcTo(center, radius, start, start + 4.5f, 16);
+    drawList->PathStroke(ImGui::GetColorU32(ImGuiCol_Text), 0, 2.0f);
+    ImGui::Dummy(ImVec2(radius * 2.0f, ImGui::GetTextLineHeight()));
+}
+
+// local date and time for the names of saved images
+static std::string galleryTimestamp()
+{
+    struct tm newtime;
+    time_t now = time(0);
+    localtime_s(&newtime, &now);
+
+    // print various components of tm structure.
+    std::string year = std::to_string(1900 + newtime.tm_year);
+    std::string month = std::to_string(1 + newtime.tm_mon);
+    std::string day = std::to_string(newtime.tm_mday);
+    std::string hour = std::to_string(newtime.tm_hour);
+    std::string min = std::to_string(newtime.tm_min);
+    std::string sec = std::to_string(newtime.tm_sec);
+
+    return year + "-" + month + "-" + day + "_" + hour + min + sec;
+}
+
+// command line usage
+static void printUsage(const char* program)
+{
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  " << program << " cluster <input.obj> <output.obj> (--resolution N | --count N)" << std::endl;
+    std::cout << "  " << program << " simplify <input.obj> <output prefix> [N ...] [--alpha A] [--max-error D]" << std::endl;
+    std::cout << "  " << program << " lights [N ...] [--frames F]" << std::endl;
+}
+
+// whole argument as a non-negative integer, false on anything else
+static bool parseCount(const char* arg, unsigned int& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    unsigned long parsed = std::strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0' || arg[0] == '-' || errno == ERANGE || parsed > std::numeric_limits<unsigned int>::max())
+        return false;
+    value = static_cast<unsigned int>(parsed);
+    return true;
+}
+
+// whole argument as a finite number, false on anything else
+static bool parseFloat(const char* arg, float& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    float parsed = std::strtof(arg, &end);
+    if (end == arg || *end != '\0' || errno == ERANGE || !std::isfinite(parsed))
+        return false;
+    value = parsed;
+    return true;
+}
+
+// keep the original coordinates, the interactive loader rescales to [-1, 1]
+static Object loadCommandLineOBJ(const std::string& filename)
+{
+    Object obj;
+    obj.loadOBJ(filename);
+    obj.TriangulateFaces();
+    return obj;
+}
+
+// vertex clustering, for models too large to open interactively
+static int runCluster(int argc, char** argv)
+{
+    if (argc != 6)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string option = argv[4];
+    unsigned int value = 0;
+    if (option != "--resolution" && option != "--count")
+    {
+        std::cout << "Unknown option " << option << std::endl;
+        return 1;
+    }
+    if (!parseCount(argv[5], value) || value == 0)
+    {
+        std::cout << "Invalid value " << argv[5] << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Object obj = loadCommandLineOBJ(argv[2]);
+    auto loaded = std::chrono::steady_clock::now();
+
+    Object simplified = option == "--resolution" ? VertexClustering(obj, value) : VertexClusteringToCount(obj, value);
+    auto clustered = std::chrono::steady_clock::now();
+
+    simplified.saveOBJ(argv[3]);
+
+    std::cout << "Input: " << obj.m_VertexPos.size() << " vertices, " << obj.m_TriFaceIndices.size() << " triangles ("
+        << std::chrono::duration<double>(loaded - start).count() << " s to load)" << std::endl;
+    std::cout << "Output: " << simplified.m_VertexPos.size() << " vertices, " << simplified.m_TriFaceIndices.size() << " triangles ("
+        << std::chrono::duration<double>(clustered - loaded).count() << " s to cluster)" << std::endl;
+
+    return 0;
+}
+
+// QEM (or Line QEM with --alpha) at several budgets from one run, writes <output prefix>_<N>.obj
+// with --max-error the run also stops at that distance, without counts it writes <output prefix>.obj
+static int runSimplify(int argc, char** argv)
+{
+    std::vector<unsigned int> desiredCounts;
+    bool lineQEM = false;
+    float alpha = 0.5f;
+    bool errorBounded = false;
+    float maxDistance = 0.0f;
+    for (int i = 4; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool valid = true;
+        if (arg == "--alpha" && i + 1 < argc)
+        {
+            lineQEM = true;
+            valid = parseFloat(argv[++i], alpha) && alpha >= 0.0f && alpha <= 1.0f;
+        }
+        else if (arg == "--max-error" && i + 1 < argc)
+        {
+            errorBounded = true;
+            valid = parseFloat(argv[++i], maxDistance) && maxDistance >= 0.0f;
+        }
+        else
+        {
+            unsigned int count = 0;
+            valid = parseCount(argv[i], count);
+            desiredCounts.push_back(count);
+        }
+
+        if (!valid)
+        {
+            std::cout << "Invalid value " << argv[i] << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc < 5 || (desiredCounts.empty() && !errorBounded))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    bool countsGiven = !desiredCounts.empty();
+    if (!countsGiven)
+        desiredCounts.push_back(0);
+    float maxError = errorBounded ? maxDistance * maxDistance : std::numeric_limits<float>::max();
+
+    auto start = std::chrono::steady_clock::now();
+    Object obj = loadCommandLineOBJ(argv[2]);
+    obj.MakeTriangleMesh(); // Triangulate first
+    auto loaded = std::chrono::steady_clock::now();
+
+    Surface GH(obj);
+    std::vector<Object> simplified = lineQEM ? GH.LineQEM(desiredCounts, alpha, maxError) : GH.QEM(desiredCounts, maxError);
+    auto simplifiedTime = std::chrono::steady_clock::now();
+
+    std::cout << "Input: " << obj.m_VertexPos.size() << " vertices, " << obj.m_TriFaceIndices.size() << " triangles ("
+        << std::chrono::duration<double>(loaded - start).count() << " s to load)" << std::endl;
+    for (unsigned int i = 0; i < simplified.size(); i++)
+    {
+        std::string filename = std::string(argv[3]) + (countsGiven ? "_" + std::to_string(desiredCounts[i]) : "") + ".obj";
+        simplified[i].saveOBJ(filename);
+        std::cout << "Output " << filename << ": " << simplified[i].m_VertexPos.size() << " vertices, "
+            << simplified[i].m_TriFaceIndices.size() << " triangles, error " << std::sqrt(GH.m_SnapshotErrors[i]) << std::endl;
+    }
+    std::cout << simplified.size() << " levels in " << std::chrono::duration<double>(simplifiedTime - loaded).count() << " s" << std::endl;
+
+    return 0;
+}
+
+// frame time of the Blinn-Phong bunny against the number of point lights, with and without clustering,
+// and with the light counts compiled into the program
+// needs a GL 4.6 context, Mesa llvmpipe gives one in software with LIBGL_ALWAYS_SOFTWARE=1
+static int runLightBenchmark(int argc, char** argv)
+{
+    std::vector<unsigned int> counts;
+    unsigned int numFrames = 30;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        unsigned int value = 0;
+        bool isFrames = arg == "--frames" && i + 1 < argc;
+        if (isFrames)
+            i++;
+        if (!parseCount(argv[i], value))
+        {
+            std::cout << "Invalid value " << argv[i] << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if (isFrames)
+            numFrames = std::max(1u, value);
+        else
+            counts.push_back(value);
+    }
+    if (counts.empty())
+        counts = { 0, 16, 64, 256, 1024 };
+
+    const unsigned int width = 960;
+    const unsigned int height = 540;
+    Window window(width, height, "Model Modifier light benchmark", false);
+    if (!window.GetID())
+        return 1;
+
+    ObjectSelect objects;
+    Mesh mesh(objects.findObj(BUNNY), SMOOTH);
+    ShadingCache objectBuffers;
+    VertexBufferLayout layout;
+    layout.Push<float>(3); // 3d coordinates
+    layout.Push<float>(3); // normals
+
+    ShaderPermutations shaders("res/shaders/phong.vert", "res/shaders/blinnPhong.frag");
+
+    // same default view as the interactive mode
+    Camera camera(0.3333f, 1.5f, 3.0f);
+    float aspectRatio = (float)width / height;
+    TransformBlock transforms;
+    transforms.model = glm::mat4(1.0f);
+    transforms.view = camera.GetViewMatrix();
+    transforms.projection = glm::perspective(glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
+    transforms.normal = glm::mat4(1.0f);
+    UniformBuffer transformBlock(sizeof(TransformBlock), TRANSFORM_BINDING);
+    transformBlock.AssignData(&transforms, sizeof(transforms));
+    UniformBuffer lightBlock(sizeof(ClusterBlock), LIGHT_BINDING);
+    MaterialBlock material = Material().GetBlock();
+    UniformBuffer materialBlock(sizeof(MaterialBlock), MATERIAL_BINDING);
+    materialBlock.AssignData(&material, sizeof(material));
+
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.80f, 0.90f, 0.96f, 1.00f);
+
+    // the cluster tiles span the framebuffer, larger than the window on high density displays
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window.GetID(), &framebufferWidth, &framebufferHeight);
+
+    LightManager lights;
+    std::cout << "lights, clustered ms/frame, specialized ms/frame, lights per cluster (avg/max), unclustered ms/frame" << std::endl;
+    for (unsigned int count : counts)
+    {
+        lights.SetPointLights(count);
+
+        // clustered, clustered with a specialized program, unclustered
+        double frameTimes[3] = { 0.0, 0.0, 0.0 };
+        float averageLights = 0.0f;
+        unsigned int maxLights = 0;
+        for (unsigned int run = 0; run < 3; run++)
+        {
+            lights.m_Clustered = run != 2;
+            lights.Build(transforms.view, glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
+
+            // the permutation is compiled before the timed frames
+            ShaderDefines defines;
+            if (run == 1)
+            {
+                defines["FLAT_SHADING"] = 0;
+                defines["GLOBAL_LIGHTS"] = lights.GetNumGlobalLights();
+                defines["CLUSTER_LIGHTS"] = lights.GetNumActiveLights() > lights.GetNumGlobalLights();
+            }
+            ShaderProgram& shader = shaders.Get(defines);
+            shader.Bind();
+            shader.SetUniform1i("flat_shading", 0);
+
+            // the first frame uploads the buffers, it is left out
+            std::chrono::steady_clock::time_point start;
+            for (unsigned int frame = 0; frame <= numFrames; frame++)
+            {
+                if (frame == 1)
+                {
+                    glFinish();
+                    start = std::chrono::steady_clock::now();
+                }
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                lights.Build(transforms.view, glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
+                lights.Upload();
+                ClusterBlock clusters = lights.GetBlock(framebufferWidth, framebufferHeight);
+                lightBlock.AssignData(&clusters, sizeof(clusters));
+
+                objectBuffers.Bind(mesh, SMOOTH, layout);
+                glDrawElements(GL_TRIANGLES, objectBuffers.GetCount(), objectBuffers.GetIndexType(), objectBuffers.GetIndexOffset(0));
+
+                glfwSwapBuffers(window.GetID());
+                glfwPollEvents();
+            }
+            glFinish();
+            frameTimes[run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / numFrames;
+
+            if (run == 0)
+            {
+                averageLights = lights.GetAverageClusterLights();
+                maxLights = lights.GetMaxClusterLights();
+            }
+        }
+
+        std::cout << count << ", " << frameTimes[0] << ", " << frameTimes[1] << ", " << averageLights << "/" << maxLights << ", " << frameTimes[2] << std::endl;
+    }
+
+    return 0;
+}
+
+static int runCommandLine(int argc, char** argv)
 {
+    std::string mode = argv[1];
+    if (mode == "cluster")
+        return runCluster(argc, argv);
+    if (mode == "simplify")
+        return runSimplify(argc, argv);
+    if (mode == "lights")
+        return runLightBenchmark(argc, argv);
+
+    printUsage(argv[0]);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        return runCommandLine(argc, argv);
+
+    // time to first frame, from here to the first swap
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    double firstFrameTime = 0.0;
+
     unsigned int screenWidth = 1440;
     unsigned int screenHeight = 810;
     float aspectRatio = (float)screenWidth / screenHeight;
@@ -139,10 +563,41 @@ int main()
     int triCount = static_cast<int>(obj.m_TriFaceIndices.size());
     int desiredTriCount = triCount;
 
+    // progressive mesh, scrubs the QEM level of detail without rerunning the simplification
+    // the steps are replayed on the mesh in place, it keeps every recorded face and obj is compacted from it when read
+    ProgressiveMesh progressiveMesh;
+    int progressiveCount = 0;
+    bool ProgressiveEdit = false;
+    bool scrubbedMesh = false;
+    std::vector<unsigned int> objVertices; // vertex of mesh for each vertex of obj, once obj is compacted from a scrubbed mesh
+
+    // Line QEM, while its result is shown another alpha simplifies the model it came from again,
+    // whose quadrics are kept so they are only reweighted
+    float lineQEMAlpha = 0.5f; // default balanced weight
+    std::shared_ptr<QuadricCache> quadricCache = std::make_shared<QuadricCache>();
+    std::shared_ptr<Object> lineQEMSource; // null once the shown model is no longer a Line QEM result
+    bool LineQEMEdit = false;
+
+    // error bounded QEM, stops by itself at the largest allowed distance to the original surface
+    float maxSimplifyError = 0.005f;
+    int reachedTriCount = -1;
+
+    // vertex clustering, by target triangle count or by grid resolution
+    bool clusterToCount = true;
+    int clusterResolution = 64;
+
     VertexBufferLayout layout;
     layout.Push<float>(3); // 3d coordinates
     layout.Push<float>(3); // normals
 
+    // layouts of the mesh vertex formats, levels of detail always use floats
+    VertexBufferLayout meshLayouts[3];
+    meshLayouts[FLOAT_VERTEX] = layout;
+    meshLayouts[SNORM16_VERTEX].Push<short>(4); // 16 bit normalized coordinates, w is padding
+    meshLayouts[SNORM16_VERTEX].Push<PackedInt2_10_10_10>(4); // normals
+    meshLayouts[HALF_VERTEX].Push<HalfFloat>(4); // 16 bit float coordinates, w is padding
+    meshLayouts[HALF_VERTEX].Push<PackedInt2_10_10_10>(4); // normals
+
     // render mode
     int currRenderMode = POLYGON;
     int nextRenderMode;
@@ -152,46 +607,84 @@ int main()
     int currShadingType = FLAT;
     int nextShadingType;
 
-    Mesh mesh(obj, currShadingType);
+    // vertex format
+    int currVertexFormat = FLOAT_VERTEX;
+    int nextVertexFormat;
+
+    Mesh mesh(obj, currShadingType, currVertexFormat);
     // keep track of number of faces
     unsigned int numFaces = static_cast<unsigned int>(mesh.m_Object.m_FaceIndices.size());
 
-    // build openGL objects using mesh
-    VertexArray objectVA;
-    VertexBuffer objectVB(mesh.m_OutVertices, mesh.m_OutNumVert * sizeof(float), DRAW_MODE::STATIC);
-    // bind vertex buffer to vertex array
-    objectVA.AddBuffer(objectVB, layout);
-    IndexBuffer objectIB(mesh.m_OutIndices, mesh.m_OutNumIdx, DRAW_MODE::STATIC);
-
-    // shaders
+    // openGL objects of the mesh, one vertex array per shading type built on first use
+    ShadingCache objectBuffers;
+
+    // level of detail chain built in the background, picked by projected screen space error
+    LODChain lodChain;
+    bool lodHalfEdge = false;
+    lodChain.Generate(obj, currShadingType, lodHalfEdge);
+    bool autoLOD = true;
+    float lodPixelError = 1.0f;
+    int currLODLevel = -1;
+    bool LoadModel = false;
+
+    // vertex dragging, moves the region around the picked vertex with a smooth falloff
+    // only the touched normals and vertex bytes are recomputed and uploaded
+    float dragRadius = 0.15f;
+    bool draggingVertex = false;
+    glm::vec3 dragAnchor, dragPlaneNormal;
+    std::vector<unsigned int> dragRegion;
+    std::vector<float> dragWeights;
+    std::vector<glm::vec3> dragOrigins;
+    // persistently mapped ring buffers instead of static buffers, for meshes rewritten every frame
+    bool streamBuffers = false;
+
+    // front-to-back triangle orders picked by view direction, and the fragments they shade
+    bool viewOrders = false;
+    Query fragmentQuery(GL_SAMPLES_PASSED);
+
+    // depth-only pass first, the lit pass then shades each visible pixel once
+    bool depthPrepass = false;
+    Query depthQuery(GL_SAMPLES_PASSED);
+
+    // shaders, programs are only built when first drawn with, from the binary cache when it has them
     std::string phongVertexPath = "res/shaders/phong.vert";
     std::string phongFragmentPath = "res/shaders/phong.frag";
-    ShaderProgram phongShader(phongVertexPath, phongFragmentPath);
+    ShaderPermutations phongShader(phongVertexPath, phongFragmentPath);
     
     std::string blinnPhongFragmentPath = "res/shaders/blinnPhong.frag";
-    ShaderProgram blinnPhongShader(phongVertexPath, blinnPhongFragmentPath);
+    ShaderPermutations blinnPhongShader(phongVertexPath, blinnPhongFragmentPath);
 
     std::string normalVertexPath = "res/shaders/normal.vert";
     std::string normalFragmentPath = "res/shaders/normal.frag";
-    ShaderProgram normalShader(normalVertexPath, normalFragmentPath);
+    ShaderPermutations normalShader(normalVertexPath, normalFragmentPath);
 
     std::string gourandVertexPath = "res/shaders/gourand.vert";
     std::string gourandFragmentPath = "res/shaders/gourand.frag";
-    ShaderProgram gourandShader(gourandVertexPath, gourandFragmentPath);
+    ShaderPermutations gourandShader(gourandVertexPath, gourandFragmentPath);
 
     std::string goochFragmentPath = "res/shaders/gooch.frag";
-    ShaderProgram goochShader(phongVertexPath, goochFragmentPath);
+    ShaderPermutations goochShader(phongVertexPath, goochFragmentPath);
 
     std::string celFragmentPath = "res/shaders/cel.frag";
-    ShaderProgram celShader(phongVertexPath, celFragmentPath);
+    ShaderPermutations celShader(phongVertexPath, celFragmentPath);
 
     std::string cookTorranceFragmentPath = "res/shaders/cookTorrance.frag";
-    ShaderProgram cookTorranceShader(phongVertexPath, cookTorranceFragmentPath);
+    ShaderPermutations cookTorranceShader(phongVertexPath, cookTorranceFragmentPath);
+
+    std::string overdrawFragmentPath = "res/shaders/overdraw.frag";
+    ShaderPermutations overdrawShader(phongVertexPath, overdrawFragmentPath);
+
+    std::string depthVertexPath = "res/shaders/depth.vert";
+    std::string depthFragmentPath = "res/shaders/depth.frag";
+    ShaderPermutations depthShader(depthVertexPath, depthFragmentPath);
 
     int currShader = NORMAL;
     int nextShader;
-    ShaderProgram shader = normalShader;
-    shader.Bind();
+    ShaderPermutations* shaderSource = &normalShader;
+    ShaderProgram* shader = nullptr;
+    // permutations compiled for the current lights and shading instead of branching on uniforms
+    bool specializedShaders = true;
+    Query litPassTimer(GL_TIME_ELAPSED);
 
     // camera setup
     float yaw = 1.5f; // radians
@@ -201,11 +694,11 @@ int main()
 
     float rotationAngle = 0.0f; // rotation angle of the object mesh
     glm::mat4 modelMatrix = glm::mat4(1.0f);
-    glm::mat4 projMatrix = glm::perspective(glm::radians(camera.m_FOV), aspectRatio, 0.1f, 1000.0f);
+    glm::mat4 projMatrix = glm::perspective(glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
 
     // lighting
-    Light light = Light();
-    std::vector<int> toggled; toggled.resize(3);
+    LightManager lights;
+    int numPointLights = 0;
 
     // Gooch variables
     std::vector<float> gooch_warm = {1, 0.25, 0};
@@ -217,8 +710,31 @@ int main()
     float metallic = 0.2f;
     float roughness = 0.3f;
 
-    // Apply modification algorithm
-    bool ModifyModel = false;
+    // uniform blocks, bound once to the binding points every shader declares them at
+    UniformBuffer transformBlock(sizeof(TransformBlock), TRANSFORM_BINDING);
+    UniformBuffer lightBlock(sizeof(ClusterBlock), LIGHT_BINDING);
+    UniformBuffer materialBlock(sizeof(MaterialBlock), MATERIAL_BINDING);
+
+    // modifications and model loads run on the geometry worker, this thread only uploads their buffers
+    // declared after the objects its jobs read, so the worker is stopped first
+    GeometryJobs geometryJobs;
+    unsigned int pendingJob = 0; // results of older jobs are dropped
+    int loadedObject = currObject; // the selection goes back to it when a load is cancelled
+    std::function<void(GeometryResult&)> pendingJobDone; // runs here once the result arrives
+    auto syncObject = [&]()
+    {
+        if (scrubbedMesh)
+        {
+            objVertices.clear();
+            obj = compactObject(mesh.m_Object, objVertices);
+        }
+    };
+    auto submitJob = [&](const std::string& name, GeometryWork work, std::function<void(GeometryResult&)> onDone = nullptr, const Object* source = nullptr)
+    {
+        syncObject();
+        pendingJob = geometryJobs.Submit(name, source ? *source : obj, work, currShadingType, currVertexFormat, viewOrders);
+        pendingJobDone = onDone;
+    };
 
     // openGL settings
     glEnable(GL_DEPTH_TEST);
@@ -230,6 +746,22 @@ int main()
     // num of triangles mode
     bool triangles = false;
 
+    // frames are only drawn when something changed, continuous rendering is kept for measuring frame times
+    bool continuousRendering = false;
+    const int REDRAW_FRAMES = 2; // drawn after the last event, ImGui answers input a frame late
+    int redrawFrames = REDRAW_FRAMES;
+    bool shaderPending = false; // a new program is compiling, the frame changes once it is ready
+
+    // images are read back a few frames later and encoded on a worker thread
+    ScreenCapture screenCapture;
+    int captureFormat = PNG_IMAGE;
+    bool screenshotRequested = false;
+    // turntable: the model turns a full circle, one saved frame per step
+    int turntableFrames = 120;
+    int turntableFrame = -1; // next step, -1 when no turntable runs
+    std::string turntableName;
+    glm::mat4 turntableStart = glm::mat4(1.0f);
+
     GLFWwindow* windowID = window.GetID();
     // input initialization & input callbacks
     Input::Init(windowID);
@@ -255,9 +787,33 @@ int main()
     /* Loop until the user closes the window */
     while (!glfwWindowShouldClose(windowID))
     {
+        ////////// wait for changes //////////
+        // nothing moves: sleep until an input event or background work posting one when it is done
+        if (!continuousRendering && redrawFrames == 0 && !shaderPending && !Input::IsAnyButtonHeld() && !geometryJobs.IsBusy() &&
+            !screenCapture.IsReading() && turntableFrame < 0)
+        {
+            // the timeout is only a safety net, events wake the wait up
+            while (!Input::ConsumeEvents() && !glfwWindowShouldClose(windowID))
+                glfwWaitEventsTimeout(0.5);
+
+            // time spent waiting is no camera movement
+            currentTime = (float)glfwGetTime();
+            redrawFrames = REDRAW_FRAMES;
+        }
+        else
+        {
+            /* Poll for and process events */
+            glfwPollEvents();
+            if (Input::ConsumeEvents())
+                redrawFrames = REDRAW_FRAMES;
+            else if (redrawFrames > 0)
+                redrawFrames--;
+        }
+
         // reset object and shader per frame
         nextObject = currObject;
         nextShadingType = currShadingType;
+        nextVertexFormat = currVertexFormat;
         nextShader = currShader;
         nextRenderMode = currRenderMode;
 
@@ -283,16 +839,80 @@ int main()
             modelMatrix = glm::rotate(modelMatrix, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
         }
 
+        // drag the vertices around the cursor
+        if (Input::IsMouseButtonDown(GLFW_MOUSE_BUTTON_2) && !ImGui::GetIO().WantCaptureMouse)
+        {
+            glm::vec3 rayOrigin, rayDirection;
+            cursorRay(currXpos, currYpos, screenWidth, screenHeight, camera.GetViewMatrix() * modelMatrix, projMatrix, rayOrigin, rayDirection);
+
+            if (!draggingVertex)
+            {
+                // edits would be lost under the result of a running modification,
+                // mixed shading would regroup its fans over the whole mesh every frame
+                int picked = geometryJobs.IsBusy() || currShadingType == MIXED ? -1 : pickVertex(mesh, rayOrigin, rayDirection, 0.02f);
+                if (picked >= 0)
+                {
+                    // the region keeps its weights and starting positions for the whole drag
+                    dragAnchor = mesh.m_Object.m_VertexPos[picked];
+                    dragPlaneNormal = rayDirection;
+                    dragRegion.clear(); dragWeights.clear(); dragOrigins.clear();
+                    for (unsigned int i = 0; i < mesh.m_Object.m_VertexPos.size(); i++)
+                    {
+                        float dist = glm::length(mesh.m_Object.m_VertexPos[i] - dragAnchor) / dragRadius;
+                        if (dist >= 1.0f || mesh.m_VertFaceCounts[i] == 0)
+                            continue;
+
+                        dragRegion.push_back(i);
+                        dragWeights.push_back((1.0f - dist * dist) * (1.0f - dist * dist));
+                        dragOrigins.push_back(mesh.m_Object.m_VertexPos[i]);
+                    }
+
+                    // simplifications of the previous shape are stale
+                    lodChain.Clear();
+                    progressiveMesh = ProgressiveMesh();
+                    quadricCache = std::make_shared<QuadricCache>();
+                    lineQEMSource = nullptr;
+                    draggingVertex = true;
+                }
+            }
+            else if (deltaX != 0.0 || deltaY != 0.0)
+            {
+                // follow the cursor on the screen parallel plane through the picked vertex
+                float denom = glm::dot(rayDirection, dragPlaneNormal);
+                if (std::abs(denom) > 1e-6f)
+                {
+                    float t = glm::dot(dragAnchor - rayOrigin, dragPlaneNormal) / denom;
+                    glm::vec3 offset = rayOrigin + t * rayDirection - dragAnchor;
+                    for (unsigned int i = 0; i < dragRegion.size(); i++)
+                    {
+                        glm::vec3 vertPos = dragOrigins[i] + dragWeights[i] * offset;
+                        mesh.m_Object.m_VertexPos[dragRegion[i]] = vertPos;
+                        if (!scrubbedMesh)
+                            obj.m_VertexPos[dragRegion[i]] = vertPos;
+                    }
+                    mesh.Update(dragRegion);
+                }
+            }
+        }
+        else
+        {
+            draggingVertex = false;
+        }
+
         // adjust FOV using vertical scroll
         if (Input::GetScrollY() != 0)
         {
             camera.changeFOV(Input::GetScrollY());
-            projMatrix = glm::perspective(glm::radians(camera.m_FOV), aspectRatio, 0.1f, 1000.0f);
+            projMatrix = glm::perspective(glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
             Input::ResetScroll();
         }
 
         ////////// clearing per frame //////////
-        glClearColor(0.80f, 0.90f, 0.96f, 1.00f);
+        // overdraw accumulates on black
+        if (currShader == OVERDRAW)
+            glClearColor(0.0f, 0.0f, 0.0f, 1.00f);
+        else
+            glClearColor(0.80f, 0.90f, 0.96f, 1.00f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         ////////// UI controls //////////
@@ -330,70 +950,239 @@ int main()
         {
             ImGui::Indent();
 
+            // one modification at a time, each one starts from the result of the previous
+            bool modifying = geometryJobs.IsBusy();
+            if (modifying)
+            {
+                std::shared_ptr<const Progress> progress = geometryJobs.GetCurrentProgress();
+                bool cancelling = progress && progress->IsCancelled();
+                ImGui::Text("%s%s", geometryJobs.GetCurrentName().c_str(), cancelling ? " (cancelling)" : "");
+                drawSpinner(6.0f);
+
+                // stages without a known amount of work only show the spinner
+                float fraction = progress ? progress->GetFraction() : -1.0f;
+                if (fraction >= 0.0f)
+                {
+                    std::string overlay = std::string(progress->GetStage()) + " " + std::to_string(static_cast<int>(fraction * 100.0f)) + "%";
+                    ImGui::ProgressBar(fraction, ImVec2(200.0f, 0.0f), overlay.c_str());
+                    ImGui::SameLine();
+                }
+                else if (progress && progress->GetStage())
+                {
+                    ImGui::Text("%s", progress->GetStage());
+                    ImGui::SameLine();
+                }
+
+                // the running algorithm returns at its next check, the current model is kept
+                ImGui::BeginDisabled(cancelling);
+                if (ImGui::Button("Cancel"))
+                {
+                    geometryJobs.Cancel();
+                    pendingJob = 0;
+                    pendingJobDone = nullptr;
+                    currObject = loadedObject;
+                }
+                ImGui::EndDisabled();
+            }
+            ImGui::BeginDisabled(modifying);
+
             if (ImGui::Button("Original"))
             {
-                obj = objects.findObj(currObject); // search for the object requested
-                ModifyModel = true;
+                int original = currObject;
+                submitJob("Loading the original model", [&objects, original](GeometryResult& result) { result.obj = objects.findObj(original); },
+                    [&](GeometryResult&) { LoadModel = true; });
             }
             if (ImGui::Button("Triangulate Surface"))
             {
-                obj.MakeTriangleMesh();
-                ModifyModel = true;
+                submitJob("Triangulating", [](GeometryResult& result) { result.obj.MakeTriangleMesh(); });
             }
             if (ImGui::Button("Beehive Surface"))
             {
-                Surface BH(obj);
-                obj = BH.Beehive();
-                ModifyModel = true;
+                submitJob("Beehive", [](GeometryResult& result) { Surface BH(result.obj, result.progress); result.obj = BH.Beehive(); });
             }
             if (ImGui::Button("SnowFlake Surface"))
             {
-                Surface SF(obj);
-                obj = SF.Snowflake();
-                ModifyModel = true;
+                submitJob("Snowflake", [](GeometryResult& result) { Surface SF(result.obj, result.progress); result.obj = SF.Snowflake(); });
             }
             if (ImGui::Button("Catmull Clark Subdivision Surface"))
             {
-                Surface CC(obj);
-                obj = CC.CatmullClark();
-                ModifyModel = true;
+                submitJob("Catmull Clark subdivision", [](GeometryResult& result) { Surface CC(result.obj, result.progress); result.obj = CC.CatmullClark(); });
             }
             if (ImGui::Button("Doo Sabin Subdivision Surface"))
             {
-                Surface DS(obj);
-                obj = DS.DooSabin();
-                ModifyModel = true;
+                submitJob("Doo Sabin subdivision", [](GeometryResult& result) { Surface DS(result.obj, result.progress); result.obj = DS.DooSabin(); });
             }
             if (ImGui::Button("Loop Subdivision Surface"))
             {
-                Surface Lo(obj);
-                obj = Lo.Loop();
-                ModifyModel = true;
+                submitJob("Loop subdivision", [](GeometryResult& result) { Surface Lo(result.obj, result.progress); result.obj = Lo.Loop(); });
             }
             if (ImGui::Button("Garland Heckbert Simplification Surface"))
             {
-                obj.MakeTriangleMesh(); // Triangulate first
-                Surface GH(obj);
-                obj = GH.QEM(desiredTriCount);
-                ModifyModel = true;
+                unsigned int count = desiredTriCount;
+                submitJob("Garland Heckbert simplification", [count](GeometryResult& result)
+                    {
+                        result.obj.MakeTriangleMesh(); // Triangulate first
+                        Surface GH(result.obj, result.progress);
+                        result.obj = GH.QEM(count);
+                    });
             }
             ImGui::Indent();
             ImGui::SliderInt("Desired count", &desiredTriCount, triCount/5, triCount);
             ImGui::Unindent();
+            if (ImGui::Button("Error Bounded Simplification Surface"))
+            {
+                float maxError = maxSimplifyError;
+                submitJob("Error bounded simplification", [maxError](GeometryResult& result)
+                    {
+                        result.obj.MakeTriangleMesh(); // Triangulate first
+                        Surface GH(result.obj, result.progress);
+                        result.obj = GH.QEMErrorBounded(maxError);
+                    },
+                    [&](GeometryResult& result) { reachedTriCount = static_cast<int>(result.obj.m_TriFaceIndices.size()); });
+            }
+            ImGui::Indent();
+            ImGui::SliderFloat("Max error", &maxSimplifyError, 0.0001f, 0.05f, "%.4f", ImGuiSliderFlags_Logarithmic);
+            if (reachedTriCount >= 0)
+                ImGui::Text("Reached %d triangles", reachedTriCount);
+            ImGui::Unindent();
+            if (ImGui::Button("Hoppe Progressive Mesh"))
+            {
+                // the shown model becomes the triangulated one the collapses index,
+                // its mesh is built here with room for every face the records rewire
+                submitJob("Recording the progressive mesh", [](GeometryResult& result)
+                    {
+                        result.obj.MakeTriangleMesh(); // Triangulate first
+                        Surface PM(result.obj, result.progress);
+                        result.progressiveMesh = PM.BuildProgressiveMesh();
+                        result.obj = result.progressiveMesh.GetFullObject();
+                        result.reservedAdjacency = result.progressiveMesh.GetAdjacency();
+                    },
+                    [&](GeometryResult& result)
+                    {
+                        progressiveMesh = std::move(result.progressiveMesh);
+                        progressiveCount = static_cast<int>(progressiveMesh.GetFaceCount());
+                        ProgressiveEdit = true;
+                    });
+            }
+            if (!progressiveMesh.Empty())
+            {
+                ImGui::Indent();
+                // each step only rewrites the faces and one-rings of its records, mixed shading cannot be patched
+                ImGui::BeginDisabled(currShadingType == MIXED);
+                if (ImGui::SliderInt("Progressive count", &progressiveCount, static_cast<int>(progressiveMesh.GetMinFaceCount()), static_cast<int>(progressiveMesh.GetMaxFaceCount())))
+                {
+                    progressiveMesh.SetFaceCount(progressiveCount);
+                    std::vector<unsigned int> changedVertices, changedFaces;
+                    progressiveMesh.TakeChanges(mesh.m_Object, changedVertices, changedFaces);
+                    mesh.Update(changedVertices, changedFaces);
+                    scrubbedMesh = true;
+
+                    numFaces = progressiveMesh.GetFaceCount();
+                    triCount = static_cast<int>(numFaces); desiredTriCount = triCount;
+                    quadricCache = std::make_shared<QuadricCache>();
+                    lineQEMSource = nullptr;
+                    lodChain.Clear();
+                    dragRegion.clear();
+                    draggingVertex = false;
+                }
+                ImGui::EndDisabled();
+                if (currShadingType == MIXED)
+                    ImGui::Text("Switch to flat or smooth shading to scrub");
+                ImGui::Unindent();
+            }
             if (ImGui::Button("Liu Rahimzadeh Zordan Simplification Surface"))
             {
-                obj.MakeTriangleMesh(); // Triangulate first
-                Surface LRZ(obj);
-                static float alpha = 0.5f; // default balanced weight
-                obj = LRZ.LineQEM(desiredTriCount, alpha);
-                ModifyModel = true;
+                unsigned int count = desiredTriCount;
+                float weight = lineQEMAlpha;
+                // the worker runs one job at a time, so the cache is never filled twice at once
+                std::shared_ptr<QuadricCache> cache = quadricCache;
+                if (!lineQEMSource)
+                {
+                    syncObject();
+                    lineQEMSource = std::make_shared<Object>(obj);
+                }
+                submitJob("Liu Rahimzadeh Zordan simplification", [count, weight, cache](GeometryResult& result)
+                    {
+                        result.obj.MakeTriangleMesh(); // Triangulate first
+                        Surface LRZ(result.obj, result.progress);
+                        result.obj = LRZ.LineQEM(count, weight, cache.get());
+                    },
+                    [&](GeometryResult&) { LineQEMEdit = true; }, lineQEMSource.get());
             }
             ImGui::Indent();
             ImGui::SliderInt("Desired count", &desiredTriCount, triCount/5, triCount);
-            static float alpha = 0.5f;
-            ImGui::SliderFloat("Alpha (edge preservation)", &alpha, 0.0f, 1.0f);
+            ImGui::SliderFloat("Alpha (edge preservation)", &lineQEMAlpha, 0.0f, 1.0f);
             ImGui::Text("0.0 = smooth, 0.5 = balanced, 1.0 = sharp edges");
             ImGui::Unindent();
+            if (ImGui::Button("Lindstrom Vertex Clustering Simplification"))
+            {
+                bool toCount = clusterToCount;
+                unsigned int count = desiredTriCount;
+                unsigned int resolution = clusterResolution;
+                submitJob("Lindstrom vertex clustering", [toCount, count, resolution](GeometryResult& result)
+                    {
+                        result.obj.MakeTriangleMesh(); // Triangulate first
+                        result.obj = toCount ? VertexClusteringToCount(result.obj, count, result.progress) : VertexClustering(result.obj, resolution, result.progress);
+                    });
+            }
+            ImGui::Indent();
+            ImGui::Checkbox("Target desired count", &clusterToCount);
+            if (clusterToCount)
+                ImGui::SliderInt("Desired count##cluster", &desiredTriCount, triCount/5, triCount);
+            else
+                ImGui::SliderInt("Grid resolution", &clusterResolution, 4, 512);
+            ImGui::Unindent();
+
+            ImGui::EndDisabled();
+            ImGui::Unindent();
+        }
+
+        if (ImGui::CollapsingHeader("Editing"))
+        {
+            ImGui::Indent();
+
+            if (currShadingType == MIXED)
+                ImGui::Text("Switch to flat or smooth shading to edit vertices");
+            else
+                ImGui::Text("Right click and drag to move vertices");
+            ImGui::SliderFloat("Drag radius", &dragRadius, 0.01f, 0.5f);
+            if (ImGui::Checkbox("Stream mesh buffers", &streamBuffers))
+                objectBuffers.SetDrawMode(streamBuffers ? DRAW_MODE::STREAM : DRAW_MODE::STATIC);
+            if (ImGui::Button("Smooth region") && !dragRegion.empty() && currShadingType != MIXED)
+            {
+                // one Laplacian step towards the average of the neighbours, weighted by the falloff
+                std::vector<glm::vec3> smoothed(dragRegion.size());
+                for (unsigned int i = 0; i < dragRegion.size(); i++)
+                {
+                    unsigned int vertIdx = dragRegion[i];
+                    glm::vec3 vertPos = mesh.m_Object.m_VertexPos[vertIdx];
+                    glm::vec3 average = glm::vec3(0.0f);
+                    unsigned int numNeighbours = 0;
+                    for (unsigned int k = mesh.m_VertFaceOffsets[vertIdx]; k < mesh.m_VertFaceOffsets[vertIdx] + mesh.m_VertFaceCounts[vertIdx]; k++)
+                    {
+                        for (unsigned int corner : mesh.m_Object.m_TriFaceIndices[mesh.m_VertFaces[k]])
+                        {
+                            if (corner == vertIdx)
+                                continue;
+                            average += mesh.m_Object.m_VertexPos[corner];
+                            numNeighbours++;
+                        }
+                    }
+                    smoothed[i] = numNeighbours > 0 ? glm::mix(vertPos, average / (float)numNeighbours, 0.5f * dragWeights[i]) : vertPos;
+                }
+                for (unsigned int i = 0; i < dragRegion.size(); i++)
+                {
+                    mesh.m_Object.m_VertexPos[dragRegion[i]] = smoothed[i];
+                    if (!scrubbedMesh)
+                        obj.m_VertexPos[dragRegion[i]] = smoothed[i];
+                }
+                mesh.Update(dragRegion);
+
+                lodChain.Clear();
+                progressiveMesh = ProgressiveMesh();
+                quadricCache = std::make_shared<QuadricCache>();
+                lineQEMSource = nullptr;
+            }
 
             ImGui::Unindent();
         }
@@ -406,6 +1195,12 @@ int main()
             ImGui::RadioButton("Mixed shading", &nextShadingType, MIXED);
             ImGui::RadioButton("Smooth shading", &nextShadingType, SMOOTH);
 
+            ImGui::Spacing();
+            ImGui::Text("Vertex format");
+            ImGui::RadioButton("32 bit float", &nextVertexFormat, FLOAT_VERTEX);
+            ImGui::RadioButton("16 bit normalized", &nextVertexFormat, SNORM16_VERTEX);
+            ImGui::RadioButton("16 bit float", &nextVertexFormat, HALF_VERTEX);
+
             ImGui::Unindent();
         }
 
@@ -420,6 +1215,7 @@ int main()
             ImGui::RadioButton("Cook-Torrance shader", &nextShader, COOKTORRANCE);
             ImGui::RadioButton("Cel shader", &nextShader, CEL);
             ImGui::RadioButton("Gooch shader", &nextShader, GOOCH);
+            ImGui::RadioButton("Overdraw", &nextShader, OVERDRAW);
         
             if (nextShader == GOURAND || nextShader == PHONG || nextShader == BLINNPHONG || nextShader == GOOCH || nextShader == CEL || nextShader == COOKTORRANCE)
             {
@@ -441,21 +1237,27 @@ int main()
                 {
                     ImGui::Indent();
 
-                    for (unsigned int l = 0; l < 3; l++)
+                    for (unsigned int l = 0; l < lights.m_NumCameraLights; l++)
                     {
+                        PointLight& cameraLight = lights.m_Lights[l];
                         ImGui::PushID(l);
                         ImGui::Text("Light #%d", l + 1);
-                        ImGui::Checkbox("Toggle light", &light.m_LightsToggled[l]);
-                        if (light.m_LightsToggled[l])
+                        ImGui::Checkbox("Toggle light", &cameraLight.enabled);
+                        if (cameraLight.enabled)
                         {
-                            ImGui::SliderFloat3("position", &light.m_Pos.data()[3 * l], -10, 10);
-                            ImGui::ColorEdit3("color", &light.m_Col.data()[3 * l]);
-                            ImGui::SliderFloat("brightness", &light.m_Brightness[l], 0, 2);
+                            ImGui::SliderFloat3("position", &cameraLight.position.x, -10, 10);
+                            ImGui::ColorEdit3("color", &cameraLight.color.x);
+                            ImGui::SliderFloat("brightness", &cameraLight.brightness, 0, 2);
 
                             ImGui::Spacing();
                         }
                         ImGui::PopID();
                     }
+
+                    // random point lights around the model, each fragment only shades the ones of its cluster
+                    if (ImGui::SliderInt("Point lights", &numPointLights, 0, 1024))
+                        lights.SetPointLights(numPointLights);
+                    ImGui::Checkbox("Clustered lighting", &lights.m_Clustered);
                     ImGui::Unindent();
                 }
 
@@ -503,6 +1305,30 @@ int main()
             ImGui::RadioButton("Polygon", &nextRenderMode, POLYGON);
             ImGui::RadioButton("Wireframe", &nextRenderMode, WIREFRAME);
             ImGui::RadioButton("Point cloud", &nextRenderMode, POINTCLOUD);
+
+            ImGui::Spacing();
+            ImGui::Checkbox("Automatic level of detail", &autoLOD);
+            if (autoLOD)
+            {
+                ImGui::Indent();
+                ImGui::SliderFloat("Pixel error", &lodPixelError, 0.25f, 10.0f);
+                // levels that only collapse onto existing vertices draw from the vertex buffer of the model (flat and smooth shading)
+                if (ImGui::Checkbox("Half-edge collapses", &lodHalfEdge) && (lodChain.IsBuilding() || lodChain.IsReady()))
+                {
+                    syncObject();
+                    lodChain.Generate(obj, currShadingType, lodHalfEdge, scrubbedMesh ? objVertices : std::vector<unsigned int>());
+                }
+                ImGui::Unindent();
+            }
+
+            // clusters of triangles sorted front to back for a few view directions, cuts overdraw of heavy shaders
+            if (ImGui::Checkbox("Front-to-back triangle order", &viewOrders))
+                mesh.SetViewOrders(viewOrders);
+
+            // only pays off when the fragment shader costs more than drawing the geometry twice
+            ImGui::Checkbox("Depth pre-pass", &depthPrepass);
+            // off, every program branches on the runtime light counts and flat shading
+            ImGui::Checkbox("Specialized shaders", &specializedShaders);
                 
             ImGui::Unindent();
         }
@@ -519,9 +1345,12 @@ int main()
             ImGui::Indent();
 
             ImGui::Checkbox("Framerate tracker", &framerate);
+            // otherwise frames are only drawn on input and finished background work
+            ImGui::Checkbox("Continuous rendering", &continuousRendering);
             if (framerate)
             {
                 ImGui::Text("Application average %.1f FPS: ", ImGui::GetIO().Framerate);
+                ImGui::Text("Time to first frame: %.0f ms", firstFrameTime);
             }
             ImGui::Checkbox("Number of Polygons", &triangles);
             if (triangles)
@@ -540,27 +1369,72 @@ int main()
                     std::string str = "Number of " + sizeStringStream.str() + "-gons: " + numStringStream.str();
                     ImGui::Text(str.c_str());
                 }
+
+                ImGui::Text("Shading buffers: %.1f MB", objectBuffers.GetUsedBytes(mesh) / (1024.0 * 1024.0));
+                ImGui::Text("Vertex size: %u bytes", Mesh::GetVertexSize(currVertexFormat));
+                ImGui::Text("Vertex cache ACMR: %.3f before, %.3f after optimization", mesh.m_ACMRBefore, mesh.m_ACMRAfter);
+                ImGui::Text("Shaded fragments: %llu", fragmentQuery.GetResult());
+                if (depthPrepass)
+                    ImGui::Text("Depth pre-pass fragments: %llu", depthQuery.GetResult());
+                ImGui::Text("Lit pass GPU time: %.3f ms", litPassTimer.GetResult() / 1e6);
+                ImGui::Text("Shader permutations: %u", shaderSource->GetNumPrograms());
+                ImGui::Text("Lights: %u, %u reaching everything, per cluster %.1f on average, %u at most", lights.GetNumActiveLights(), lights.GetNumGlobalLights(), lights.GetAverageClusterLights(), lights.GetMaxClusterLights());
+                if (currVertexFormat != FLOAT_VERTEX)
+                    ImGui::Text("Max position error %.2e, normal error %.2e", mesh.m_MaxPositionError, mesh.m_MaxNormalError);
+                if (mesh.m_PackedFormat != currVertexFormat)
+                    ImGui::Text("Positions leave [-1, 1], packed as half floats");
+
+                if (lodChain.IsBuilding())
+                    ImGui::Text("Building levels of detail...");
+                else if (currLODLevel >= 0)
+                    ImGui::Text("Level of detail %d: %u triangles", currLODLevel + 1, lodChain.GetNumFaces(currLODLevel));
+                else
+                    ImGui::Text("Level of detail: full");
             }
 
             ImGui::Unindent();
         }
 
-        if (ImGui::Button("Screenshot"))
+        if (ImGui::CollapsingHeader("Capture"))
         {
-            struct tm newtime;
-            time_t now = time(0);
-            localtime_s(&newtime, &now);
+            ImGui::Indent();
 
-            // print various components of tm structure.
-            std::string year = std::to_string(1900 + newtime.tm_year);
-            std::string month = std::to_string(1 + newtime.tm_mon);
-            std::string day = std::to_string(newtime.tm_mday);
-            std::string hour = std::to_string(newtime.tm_hour);
-            std::string min = std::to_string(newtime.tm_min);
-            std::string sec = std::to_string(newtime.tm_sec);
+            ImGui::RadioButton("PNG", &captureFormat, PNG_IMAGE);
+            ImGui::RadioButton("PNG, fast compression", &captureFormat, PNG_FAST_IMAGE);
+            ImGui::RadioButton("TGA, run length encoded", &captureFormat, TGA_IMAGE);
+            ImGui::RadioButton("BMP, uncompressed", &captureFormat, BMP_IMAGE);
 
-            std::string path = "gallery/Screenshot_" + year + "-" + month + "-" + day + "_" + hour + min + sec + ".png";
-            saveImage(path.c_str(), windowID);
+            // turntable frames are saved without the interface
+            if (turntableFrame < 0)
+            {
+                ImGui::SliderInt("Turntable frames", &turntableFrames, 12, 360);
+                if (ImGui::Button("Turntable"))
+                {
+                    turntableFrame = 0;
+                    turntableStart = modelMatrix;
+                    turntableName = "gallery/Turntable_" + galleryTimestamp() + "_";
+                }
+            }
+            else
+            {
+                ImGui::Text("Turntable frame %d of %d", turntableFrame, turntableFrames);
+                if (ImGui::Button("Stop turntable"))
+                {
+                    modelMatrix = turntableStart;
+                    turntableFrame = -1;
+                }
+            }
+
+            if (screenCapture.GetNumQueued() > 0)
+                ImGui::Text("Saving %u images", screenCapture.GetNumQueued());
+            ImGui::Text("Images saved: %u", screenCapture.GetNumSaved());
+
+            ImGui::Unindent();
+        }
+
+        if (ImGui::Button("Screenshot"))
+        {
+            screenshotRequested = true;
         }
 
         ImGui::End();
@@ -574,68 +1448,100 @@ int main()
             currShader = nextShader;
 
             if (currShader == PHONG)
-                shader = phongShader;
+                shaderSource = &phongShader;
             else if (currShader == BLINNPHONG)
-                shader = blinnPhongShader;
+                shaderSource = &blinnPhongShader;
             else if (currShader == GOURAND)
-                shader = gourandShader;
+                shaderSource = &gourandShader;
             else if (currShader == NORMAL)
-                shader = normalShader;
+                shaderSource = &normalShader;
             else if (currShader == GOOCH)
-                shader = goochShader;
+                shaderSource = &goochShader;
             else if (currShader == CEL)
-                shader = celShader;
+                shaderSource = &celShader;
             else if (currShader == COOKTORRANCE)
-                shader = cookTorranceShader;
+                shaderSource = &cookTorranceShader;
+            else if (currShader == OVERDRAW)
+                shaderSource = &overdrawShader;
+        }
 
-            shader.Bind();
+        ////////// turntable //////////
+        // a step waits while the encoder is behind, so no frame of the circle is dropped
+        bool captureTurntable = false;
+        if (turntableFrame >= 0 && screenCapture.CanCapture())
+        {
+            float angle = 360.0f * turntableFrame / turntableFrames;
+            modelMatrix = glm::rotate(turntableStart, glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
+            captureTurntable = true;
         }
 
         ////////// upload uniforms //////////
-        shader.SetUniformMat4f("u_Model", modelMatrix);
-        shader.SetUniformMat4f("u_View", camera.GetViewMatrix());
-        shader.SetUniformMat4f("u_Projection", projMatrix);
-        if (currShader == GOURAND || currShader == PHONG || currShader == BLINNPHONG || currShader == GOOCH || currShader == CEL || currShader == COOKTORRANCE)
+        // the blocks are shared by every program and only sent when their content changed
+        TransformBlock transforms;
+        transforms.model = modelMatrix;
+        transforms.view = camera.GetViewMatrix();
+        transforms.projection = projMatrix;
+        transforms.normal = glm::transpose(glm::inverse(modelMatrix));
+        transformBlock.AssignData(&transforms, sizeof(transforms));
+
+        // lights are sorted into the clusters of this view every frame,
+        // the shaders find their tile from the pixel position so the grid spans the framebuffer
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(windowID, &framebufferWidth, &framebufferHeight);
+        lights.Build(camera.GetViewMatrix(), glm::radians(camera.m_FOV), aspectRatio, NEAR_PLANE, FAR_PLANE);
+        lights.Upload();
+        ClusterBlock clusters = lights.GetBlock(framebufferWidth, framebufferHeight);
+        lightBlock.AssignData(&clusters, sizeof(clusters));
+
+        MaterialBlock material = meshMat.GetBlock();
+        material.warm = glm::vec3(gooch_warm[0], gooch_warm[1], gooch_warm[2]);
+        material.cool = glm::vec3(gooch_cool[0], gooch_cool[1], gooch_cool[2]);
+        material.alpha = gooch_alpha;
+        material.beta = gooch_beta;
+        material.metallic = metallic;
+        material.roughness = roughness;
+        materialBlock.AssignData(&material, sizeof(material));
+
+        ////////// pick shader permutation //////////
+        // flat shading shares the indexed vertices, face normals come from the fragment derivatives of filled polygons
+        int flatShading = currShadingType == FLAT && currRenderMode == POLYGON;
+        ShaderDefines defines;
+        if (specializedShaders)
         {
-            shader.SetUniform3fv("light_pos", 3, light.m_Pos.data());
-            shader.SetUniform3fv("light_col", 3, light.m_Col.data());
-            shader.SetUniform3f("light_brightness", light.m_Brightness[0], light.m_Brightness[1], light.m_Brightness[2]);
-            ////////// cast bool to int /////////
-            for (unsigned int i = 0; i < 3; i++)
+            defines["FLAT_SHADING"] = flatShading;
+            // only the lit shaders read the lights, the others keep a single permutation per shading
+            if (currShader != NORMAL && currShader != OVERDRAW)
             {
-                toggled[i] = static_cast<int>(light.m_LightsToggled[i]);
+                defines["GLOBAL_LIGHTS"] = lights.GetNumGlobalLights();
+                defines["CLUSTER_LIGHTS"] = lights.GetNumActiveLights() > lights.GetNumGlobalLights();
             }
-            shader.SetUniform1iv("light_toggled", 3, toggled.data()); // upload the lights toggle option
-
-            shader.SetUniform3fv("ambient", 1, meshMat.m_Ambient.data());
-            shader.SetUniform3fv("diffuse", 1, meshMat.m_Diffuse.data());
-            shader.SetUniform3fv("specular", 1, meshMat.m_Specular.data());
-            shader.SetUniform1f("shine", meshMat.m_Shine);
+        }
 
-            if (currShader == GOOCH)
-            {
-                shader.SetUniform3fv("warm", 1, gooch_warm.data());
-                shader.SetUniform3fv("cool", 1, gooch_cool.data());
-                shader.SetUniform1f("alpha", gooch_alpha);
-                shader.SetUniform1f("beta", gooch_beta);
-            }
-            if (currShader == COOKTORRANCE)
-            {
-                shader.SetUniform1f("metallic", metallic);
-                shader.SetUniform1f("roughness", roughness);
-            }
+        // the current program keeps drawing while the driver compiles the next one in the background
+        ShaderProgram* nextProgram = &shaderSource->Get(defines);
+        if (nextProgram != shader && (nextProgram->IsReady() || !shader))
+        {
+            shader = nextProgram;
+            shader->Bind();
         }
+        shaderPending = nextProgram != shader;
+        // ignored by specialized programs, they have no such uniform
+        shader->SetUniform1i("flat_shading", flatShading);
 
         ////////// regenerate object //////////
         if (nextShadingType != currShadingType)
         {
             currShadingType = nextShadingType;
 
-            mesh.Rebuild(currShadingType); // rebuild mesh based on shading type
+            // the mesh buffers of the new shading are built or picked from the cache when drawing
+            lodChain.Rebuild(currShadingType);
+        }
 
-            objectVA.Bind();
-            objectVB.AssignData(mesh.m_OutVertices, mesh.m_OutNumVert * sizeof(float), DRAW_MODE::STATIC);
-            objectIB.AssignData(mesh.m_OutIndices, mesh.m_OutNumIdx, DRAW_MODE::STATIC);
+        ////////// change vertex format //////////
+        if (nextVertexFormat != currVertexFormat)
+        {
+            currVertexFormat = nextVertexFormat;
+            mesh.SetVertexFormat(currVertexFormat); // new version, buffers are packed again when drawing
         }
 
         ////////// regenerate object //////////
@@ -643,24 +1549,64 @@ int main()
         {
             currObject = nextObject;
 
-            obj = objects.findObj(currObject); // search for the object requested
-            triCount = static_cast<int>(obj.m_TriFaceIndices.size()); desiredTriCount = triCount;
-            
-            ModifyModel = true;
+            // a model still being modified is replaced, its result is dropped
+            int requested = currObject;
+            submitJob("Loading the model", [&objects, requested](GeometryResult& result) { result.obj = objects.findObj(requested); },
+                [&, requested](GeometryResult&) { LoadModel = true; loadedObject = requested; });
         }
 
-        ////////// apply modification //////////
-        if (ModifyModel)
+        ////////// finished background modifications //////////
+        bool ModelChanged = false;
+        for (std::unique_ptr<GeometryResult>& result : geometryJobs.Collect())
+        {
+            if (result->id != pendingJob)
+                continue;
+
+            if (result->changed)
+            {
+                // the buffers were built on the worker, they are uploaded when drawing
+                obj = std::move(result->obj);
+                mesh.Replace(*result->mesh);
+                // settings changed while the job was running
+                mesh.SetVertexFormat(currVertexFormat);
+                mesh.SetViewOrders(viewOrders);
+                ModelChanged = true;
+            }
+            if (pendingJobDone)
+                pendingJobDone(*result);
+            pendingJob = 0;
+            pendingJobDone = nullptr;
+        }
+
+        if (ModelChanged)
         {
-            mesh.Rebuild(obj); // rebuild mesh based on object info
             numFaces = static_cast<unsigned int>(mesh.m_Object.m_FaceIndices.size()); // update number of faces
             triCount = static_cast<int>(obj.m_TriFaceIndices.size()); desiredTriCount = triCount;
 
-            objectVA.Bind();
-            objectVB.AssignData(mesh.m_OutVertices, mesh.m_OutNumVert * sizeof(float), DRAW_MODE::STATIC);
-            objectIB.AssignData(mesh.m_OutIndices, mesh.m_OutNumIdx, DRAW_MODE::STATIC);
-
-            ModifyModel = false;
+            // any other modification invalidates the recorded collapses
+            if (!ProgressiveEdit)
+                progressiveMesh = ProgressiveMesh();
+            ProgressiveEdit = false;
+            scrubbedMesh = false;
+            objVertices.clear();
+            // only a Line QEM result keeps the model it came from and its quadrics
+            if (!LineQEMEdit)
+            {
+                lineQEMSource = nullptr;
+                quadricCache = std::make_shared<QuadricCache>();
+            }
+            LineQEMEdit = false;
+
+            // the edited region belongs to the previous shape
+            dragRegion.clear();
+            draggingVertex = false;
+
+            // levels of detail are only built for freshly loaded models
+            if (LoadModel)
+                lodChain.Generate(obj, currShadingType, lodHalfEdge);
+            else
+                lodChain.Clear();
+            LoadModel = false;
         }
 
         ////////// change render mode //////////
@@ -676,18 +1622,110 @@ int main()
                 glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
         }
 
+        ////////// pick level of detail //////////
+        lodChain.Poll(mesh, layout);
+        currLODLevel = -1;
+        if (autoLOD)
+        {
+            float cameraDist = glm::length(camera.GetCameraPosition());
+            currLODLevel = lodChain.SelectLevel(cameraDist, glm::radians(camera.m_FOV), (float)screenHeight, lodPixelError);
+        }
+
         ////////// Render object here //////////
-        glDrawElements(GL_TRIANGLES, objectIB.GetCount(), GL_UNSIGNED_INT, 0);
+        // overdraw adds up every fragment that passes the depth test
+        if (currShader == OVERDRAW)
+            glBlendFunc(GL_ONE, GL_ONE);
+        else
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        // both passes draw the same buffers with the same triangle order
+        auto drawObject = [&]()
+        {
+            if (currLODLevel >= 0)
+            {
+                // half-edge levels index the vertex buffer of the object, the others have their own
+                if (lodChain.IsShared())
+                    objectBuffers.Bind(mesh, currShadingType, meshLayouts[mesh.m_PackedFormat]);
+                lodChain.Bind(currLODLevel);
+                glDrawElements(GL_TRIANGLES, lodChain.GetCount(currLODLevel), lodChain.GetIndexType(currLODLevel), 0);
+            }
+            else
+            {
+                objectBuffers.Bind(mesh, currShadingType, meshLayouts[mesh.m_PackedFormat]);
+
+                // view direction in object space picks the triangle order
+                glm::vec3 objectFront = glm::normalize(glm::inverse(glm::mat3(modelMatrix)) * camera.GetCameraFront());
+                unsigned int viewOrder = mesh.SelectViewOrder(objectFront);
+                glDrawElements(GL_TRIANGLES, objectBuffers.GetCount(), objectBuffers.GetIndexType(), objectBuffers.GetIndexOffset(viewOrder));
+            }
+        };
+
+        if (depthPrepass)
+        {
+            // lay down the nearest depth without touching the color buffer
+            depthShader.Get(ShaderDefines()).Bind();
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            depthQuery.Begin();
+            drawObject();
+            depthQuery.End();
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+            // only the fragments at that exact depth are shaded, depth is already final
+            shader->Bind();
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+
+        litPassTimer.Begin();
+        fragmentQuery.Begin();
+        drawObject();
+        fragmentQuery.End();
+        litPassTimer.End();
+
+        if (depthPrepass)
+        {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+
+        ////////// capture images //////////
+        if (captureTurntable)
+        {
+            std::string number = std::to_string(turntableFrame);
+            number.insert(0, number.size() < 4 ? 4 - number.size() : 0, '0');
+            screenCapture.Capture(turntableName + number, framebufferWidth, framebufferHeight, captureFormat);
+
+            turntableFrame++;
+            if (turntableFrame == turntableFrames)
+            {
+                modelMatrix = turntableStart;
+                turntableFrame = -1;
+            }
+        }
 
         ////////// Render Imgui here //////////
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        // screenshots keep the interface
+        if (screenshotRequested)
+        {
+            screenCapture.Capture("gallery/Screenshot_" + galleryTimestamp(), framebufferWidth, framebufferHeight, captureFormat);
+            screenshotRequested = false;
+        }
+        screenCapture.Poll();
+
         /* Swap front and back buffers */
         glfwSwapBuffers(windowID);
 
-        /* Poll for and process events */
-        glfwPollEvents();
+        if (firstFrameTime == 0.0)
+        {
+            firstFrameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            std::cout << "First frame after " << firstFrameTime << " ms, shader " << (shader->IsFromCache() ? "loaded from the binary cache" : "compiled") << std::endl;
+        }
     }
+    // the last copies are read back while the context still exists, the encoder finishes them
+    screenCapture.Shutdown();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
 
@@ -74,6 +74,11 @@ void Camera::ResetView()
     SetViewMatrix();
 }
 
+glm::vec3 Camera::GetCameraPosition() const
+{
+    return m_CameraPosition;
+}
+
 glm::vec3 Camera::GetCameraFront() const
 {
     return m_CameraFront;
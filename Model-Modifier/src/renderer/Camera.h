@@ -33,6 +33,7 @@ public:
 
 	void ResetView();
 
+	glm::vec3 GetCameraPosition() const;
 	glm::vec3 GetCameraFront() const;
 	glm::vec3 GetCameraRight() const;
 	glm::vec3 GetCameraUp() const;
@@ -0,0 +1,189 @@
+#include "GrowableBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+GrowableBuffer::GrowableBuffer(unsigned int target)
+	: m_ID(0), m_Target(target), m_Mode(DRAW_MODE::STATIC), m_Size(0), m_Capacity(0),
+	  m_Mapped(nullptr), m_Region(0), m_Fences{}
+{
+	glGenBuffers(1, &m_ID);
+}
+
+GrowableBuffer::~GrowableBuffer()
+{
+	Release();
+}
+
+void GrowableBuffer::Assign(const void* data, unsigned int size, DRAW_MODE mode)
+{
+	if (mode == DRAW_MODE::STREAM)
+	{
+		void* region = MapRegion(size);
+		if (data && size > 0)
+			std::memcpy(region, data, size);
+		return;
+	}
+
+	// growing by half again keeps repeated edits from reallocating every time,
+	// a much smaller buffer gives its memory back
+	if (mode != m_Mode || size > m_Capacity || size < m_Capacity / 4)
+	{
+		unsigned int capacity = size;
+		if (mode == m_Mode && size > m_Capacity && m_Capacity > 0)
+			capacity = std::max(size, m_Capacity + m_Capacity / 2);
+		Allocate(capacity, mode);
+	}
+
+	m_Size = size;
+	glBindBuffer(m_Target, m_ID);
+	if (data && size > 0)
+		glBufferSubData(m_Target, 0, size, data);
+}
+
+void GrowableBuffer::AssignSub(const void* data, unsigned int offset, unsigned int size) const
+{
+	// the GPU may still read the current region of a streamed buffer
+	if (m_Mode == DRAW_MODE::STREAM || offset + size > m_Size)
+	{
+		std::cout << "Buffer sub data error." << std::endl;
+		return;
+	}
+
+	glBindBuffer(m_Target, m_ID);
+	glBufferSubData(m_Target, offset, size, data);
+}
+
+void* GrowableBuffer::MapRegion(unsigned int size)
+{
+	if (m_Mode != DRAW_MODE::STREAM || size > m_Capacity)
+	{
+		unsigned int capacity = size;
+		if (m_Mode == DRAW_MODE::STREAM && m_Capacity > 0)
+			capacity = std::max(size, m_Capacity + m_Capacity / 2);
+		Allocate(capacity, DRAW_MODE::STREAM);
+	}
+	else
+	{
+		// the commands issued since the last write read the current region, fence it before moving on
+		m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_Region = (m_Region + 1) % STREAM_REGIONS;
+		WaitRegion(m_Region);
+	}
+
+	m_Size = size;
+	return m_Mapped + static_cast<size_t>(m_Region) * m_Capacity;
+}
+
+void GrowableBuffer::Allocate(unsigned int capacity, DRAW_MODE mode)
+{
+	if (mode == DRAW_MODE::STREAM || m_Mode == DRAW_MODE::STREAM)
+	{
+		// immutable storage cannot be resized, it takes a new buffer name
+		Release();
+		glGenBuffers(1, &m_ID);
+	}
+	m_Mode = mode;
+	m_Size = 0;
+	glBindBuffer(m_Target, m_ID);
+
+	if (mode == DRAW_MODE::STATIC)
+	{
+		m_Capacity = capacity;
+		glBufferData(m_Target, m_Capacity, nullptr, GL_STATIC_DRAW);
+	}
+	else if (mode == DRAW_MODE::DYNAMIC)
+	{
+		m_Capacity = capacity;
+		glBufferData(m_Target, m_Capacity, nullptr, GL_DYNAMIC_DRAW);
+	}
+	else if (mode == DRAW_MODE::STREAM)
+	{
+		// regions stay 4 byte aligned so indices and attributes can start at their offset
+		m_Capacity = std::max((capacity + 3u) & ~3u, 4u);
+		m_Region = 0;
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr totalSize = static_cast<GLsizeiptr>(m_Capacity) * STREAM_REGIONS;
+		glBufferStorage(m_Target, totalSize, nullptr, flags);
+		m_Mapped = static_cast<unsigned char*>(glMapBufferRange(m_Target, 0, totalSize, flags));
+		if (!m_Mapped)
+			std::cout << "Buffer mapping error." << std::endl;
+	}
+	else
+	{
+		std::cout << "Buffer mode error." << std::endl;
+	}
+}
+
+void GrowableBuffer::Release()
+{
+	for (GLsync& fence : m_Fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (m_Mapped)
+	{
+		glBindBuffer(m_Target, m_ID);
+		glUnmapBuffer(m_Target);
+		m_Mapped = nullptr;
+	}
+	glDeleteBuffers(1, &m_ID);
+	m_ID = 0;
+	m_Capacity = 0;
+	m_Size = 0;
+}
+
+void GrowableBuffer::WaitRegion(unsigned int region)
+{
+	GLsync& fence = m_Fences[region];
+	if (!fence)
+		return;
+
+	// usually signaled long ago, the ring only fills up when the CPU writes faster than the GPU draws
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while (status == GL_TIMEOUT_EXPIRED)
+	{
+		status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+}
+
+void GrowableBuffer::Bind() const
+{
+	glBindBuffer(m_Target, m_ID);
+}
+
+void GrowableBuffer::Unbind() const
+{
+	glBindBuffer(m_Target, 0);
+}
+
+void GrowableBuffer::BindBase(unsigned int binding) const
+{
+	glBindBufferBase(m_Target, binding, m_ID);
+}
+
+DRAW_MODE GrowableBuffer::GetMode() const
+{
+	return m_Mode;
+}
+
+unsigned int GrowableBuffer::GetSize() const
+{
+	return m_Size;
+}
+
+unsigned int GrowableBuffer::GetCapacity() const
+{
+	return m_Capacity;
+}
+
+unsigned int GrowableBuffer::GetOffset() const
+{
+	return m_Mode == DRAW_MODE::STREAM ? m_Region * m_Capacity : 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "glad/glad.h"
+
+enum class DRAW_MODE {
+	STATIC, DYNAMIC, STREAM
+};
+
+// regions of a streamed buffer, the CPU fills one while the GPU may still read the others
+const unsigned int STREAM_REGIONS = 3;
+
+// GL buffer storage shared by vertex and index buffers
+// the storage is reused while new data fits and grows geometrically when it does not,
+// streamed buffers stay persistently mapped and cycle through fenced regions
+class GrowableBuffer
+{
+private:
+	unsigned int m_ID;
+	unsigned int m_Target;
+	DRAW_MODE m_Mode;
+	unsigned int m_Size; // bytes of the current data
+	unsigned int m_Capacity; // bytes of storage, per region when streaming
+
+	unsigned char* m_Mapped;
+	unsigned int m_Region; // region holding the current data
+	GLsync m_Fences[STREAM_REGIONS];
+
+public:
+	GrowableBuffer(unsigned int target);
+	~GrowableBuffer();
+
+	void Assign(const void* data, unsigned int size, DRAW_MODE mode);
+	void AssignSub(const void* data, unsigned int offset, unsigned int size) const;
+	// stream the next size bytes: waits until the GPU is done with the next region and returns it to be written
+	void* MapRegion(unsigned int size);
+
+	void Bind() const;
+	void Unbind() const;
+	// attach to an indexed binding point, for uniform and shader storage buffers
+	void BindBase(unsigned int binding) const;
+
+	DRAW_MODE GetMode() const;
+	unsigned int GetSize() const;
+	unsigned int GetCapacity() const;
+	// byte offset of the current data, only moves when streaming
+	unsigned int GetOffset() const;
+
+private:
+	void Allocate(unsigned int capacity, DRAW_MODE mode);
+	void Release();
+	void WaitRegion(unsigned int region);
+};
@@ -2,58 +2,108 @@
 
 #include <glad/glad.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 IndexBuffer::IndexBuffer(const void* data, unsigned int count, DRAW_MODE mode)
-	: m_Count(count)
+	: m_Buffer(GL_ELEMENT_ARRAY_BUFFER), m_Count(count), m_Type(GL_UNSIGNED_INT)
 {
-	glGenBuffers(1, &m_ID);
 	AssignData(data, count, mode);
-
-	int bufferSize;
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &bufferSize);
-	if (m_Count * sizeof(unsigned int) != bufferSize)
-	{
-		glDeleteBuffers(1, &m_ID);
-		std::cout << "Buffer error." << std::endl;
-	}
 }
 
 IndexBuffer::~IndexBuffer()
 {
-	glDeleteBuffers(1, &m_ID);
 }
 
 void IndexBuffer::AssignData(const void* data, unsigned int count, DRAW_MODE mode)
 {
 	m_Count = count;
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
-	if (mode == DRAW_MODE::STATIC)
+
+	// 16 bit indices halve the buffer and the index fetches
+	const unsigned int* indices = static_cast<const unsigned int*>(data);
+	m_Type = GL_UNSIGNED_INT;
+	if (indices && (m_Count == 0 || *std::max_element(indices, indices + m_Count) <= 0xFFFF))
+		m_Type = GL_UNSIGNED_SHORT;
+
+	if (mode == DRAW_MODE::STREAM)
 	{
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Count * sizeof(unsigned int), data, GL_STATIC_DRAW);
+		void* region = m_Buffer.MapRegion(m_Count * GetSizeOfIndex());
+		if (!indices)
+			return;
+
+		if (m_Type == GL_UNSIGNED_SHORT)
+		{
+			unsigned short* shortIndices = static_cast<unsigned short*>(region);
+			for (unsigned int i = 0; i < m_Count; i++)
+			{
+				shortIndices[i] = static_cast<unsigned short>(indices[i]);
+			}
+		}
+		else
+		{
+			std::memcpy(region, indices, m_Count * sizeof(unsigned int));
+		}
+		return;
 	}
-	else if (mode == DRAW_MODE::DYNAMIC)
+
+	std::vector<unsigned short> shortIndices;
+	if (m_Type == GL_UNSIGNED_SHORT)
 	{
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_Count * sizeof(unsigned int), data, GL_DYNAMIC_DRAW);
+		shortIndices.assign(indices, indices + m_Count);
+		data = shortIndices.data();
 	}
-	else
+	m_Buffer.Assign(data, m_Count * GetSizeOfIndex(), mode);
+}
+
+bool IndexBuffer::AssignSubData(const void* data, unsigned int first, unsigned int count) const
+{
+	const unsigned int* indices = static_cast<const unsigned int*>(data);
+	if (m_Type == GL_UNSIGNED_INT)
 	{
-		glDeleteBuffers(1, &m_ID);
-		std::cout << "Buffer mode error." << std::endl;
+		m_Buffer.AssignSub(indices, first * sizeof(unsigned int), count * sizeof(unsigned int));
+		return true;
 	}
+
+	if (count > 0 && *std::max_element(indices, indices + count) > 0xFFFF)
+		return false;
+
+	std::vector<unsigned short> shortIndices(indices, indices + count);
+	m_Buffer.AssignSub(shortIndices.data(), first * sizeof(unsigned short), count * sizeof(unsigned short));
+	return true;
 }
 
 void IndexBuffer::Bind() const
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ID);
+	m_Buffer.Bind();
 }
 
 void IndexBuffer::Unbind() const
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	m_Buffer.Unbind();
 }
 
 unsigned int IndexBuffer::GetCount() const
 {
 	return m_Count;
 }
+
+unsigned int IndexBuffer::GetType() const
+{
+	return m_Type;
+}
+
+unsigned int IndexBuffer::GetSizeOfIndex() const
+{
+	return m_Type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+unsigned int IndexBuffer::GetCapacity() const
+{
+	return m_Buffer.GetCapacity();
+}
+
+unsigned int IndexBuffer::GetOffset() const
+{
+	return m_Buffer.GetOffset();
+}
@@ -1,21 +1,32 @@
 #pragma once
 
-#include "VertexBuffer.h"
+#include "GrowableBuffer.h"
 
 class IndexBuffer
 {
 private:
-	unsigned int m_ID;
+	GrowableBuffer m_Buffer;
 	unsigned int m_Count;
+	unsigned int m_Type; // GL_UNSIGNED_SHORT whenever every index fits, GL_UNSIGNED_INT otherwise
 
 public:
+	// data holds 32 bit indices, they are narrowed on upload when possible
 	IndexBuffer(const void* data, unsigned int count, DRAW_MODE mode);
 	~IndexBuffer();
 
+	// reuses the storage when the indices fit, streamed indices are written straight into mapped memory
 	void AssignData(const void* data, unsigned int count, DRAW_MODE mode);
+	// overwrite count indices from first, in the narrowed type, the storage keeps its size
+	// returns false when an index does not fit 16 bit indices, AssignData must take them all again
+	bool AssignSubData(const void* data, unsigned int first, unsigned int count) const;
 
 	void Bind() const;
 	void Unbind() const;
 
 	unsigned int GetCount() const;
-};
\ No newline at end of file
+	unsigned int GetType() const;
+	unsigned int GetSizeOfIndex() const;
+	unsigned int GetCapacity() const;
+	// byte offset of the current indices, to add to the offset passed to glDrawElements
+	unsigned int GetOffset() const;
+};
@@ -3,6 +3,8 @@
 GLFWwindow* Input::m_WindowID;
 float Input::m_ScrollX = 0.0f;
 float Input::m_ScrollY = 0.0f;
+std::atomic<bool> Input::m_EventPending{ true };
+int Input::m_NumButtonsHeld = 0;
 
 void Input::Init(GLFWwindow* window)
 {
@@ -12,9 +14,15 @@ void Input::Init(GLFWwindow* window)
 
 void Input::SetCallbacks()
 {
-    //glfwSetKeyCallback(m_WindowID, keyboard);
+    // set before ImGui installs its own, which forwards the events here
     glfwSetFramebufferSizeCallback(m_WindowID, Input::FramebufferSizeCallback);
     glfwSetScrollCallback(m_WindowID, Input::ScrollCallback);
+    glfwSetKeyCallback(m_WindowID, Input::KeyCallback);
+    glfwSetMouseButtonCallback(m_WindowID, Input::MouseButtonCallback);
+    glfwSetCursorPosCallback(m_WindowID, Input::CursorPosCallback);
+    glfwSetCharCallback(m_WindowID, Input::CharCallback);
+    glfwSetWindowFocusCallback(m_WindowID, Input::WindowFocusCallback);
+    glfwSetWindowRefreshCallback(m_WindowID, Input::WindowRefreshCallback);
 }
 
 bool Input::IsKeyDown(int keycode)
@@ -43,13 +51,72 @@ void Input::ResetScroll()
     m_ScrollY = 0.0f;
 }
 
-void Input::FramebufferSizeCallback(GLFWwindow* window, int width, int height)
+void Input::PostEvent()
+{
+    m_EventPending = true;
+    glfwPostEmptyEvent();
+}
+
+bool Input::ConsumeEvents()
+{
+    return m_EventPending.exchange(false);
+}
+
+bool Input::IsAnyButtonHeld()
+{
+    return m_NumButtonsHeld > 0;
+}
+
+void Input::FramebufferSizeCallback(GLFWwindow* /*window*/, int width, int height)
 {
     glViewport(0, 0, width, height);
+    m_EventPending = true;
 }
 
-void Input::ScrollCallback(GLFWwindow* window, double xOffset, double yOffset)
+void Input::ScrollCallback(GLFWwindow* /*window*/, double xOffset, double yOffset)
 {
 	m_ScrollX = (float)xOffset;
 	m_ScrollY = (float)yOffset;
+	m_EventPending = true;
+}
+
+void Input::KeyCallback(GLFWwindow* /*window*/, int /*key*/, int /*scancode*/, int action, int /*mods*/)
+{
+    if (action == GLFW_PRESS)
+        m_NumButtonsHeld++;
+    else if (action == GLFW_RELEASE && m_NumButtonsHeld > 0)
+        m_NumButtonsHeld--;
+    m_EventPending = true;
+}
+
+void Input::MouseButtonCallback(GLFWwindow* /*window*/, int /*button*/, int action, int /*mods*/)
+{
+    if (action == GLFW_PRESS)
+        m_NumButtonsHeld++;
+    else if (action == GLFW_RELEASE && m_NumButtonsHeld > 0)
+        m_NumButtonsHeld--;
+    m_EventPending = true;
+}
+
+void Input::CursorPosCallback(GLFWwindow* /*window*/, double /*xPos*/, double /*yPos*/)
+{
+    m_EventPending = true;
+}
+
+void Input::CharCallback(GLFWwindow* /*window*/, unsigned int /*codepoint*/)
+{
+    m_EventPending = true;
+}
+
+void Input::WindowFocusCallback(GLFWwindow* /*window*/, int focused)
+{
+    // releases may be lost while the window is in the background
+    if (!focused)
+        m_NumButtonsHeld = 0;
+    m_EventPending = true;
+}
+
+void Input::WindowRefreshCallback(GLFWwindow* /*window*/)
+{
+    m_EventPending = true;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "GLFW/glfw3.h"
 
 class Input
@@ -16,13 +18,27 @@ public:
 
 	static void ResetScroll();
 
+	// something to redraw for: an input event, or work finished on another thread
+	static void PostEvent(); // thread safe, wakes the main thread waiting for events
+	static bool ConsumeEvents();
+	// keys or mouse buttons held down, the view keeps changing without new events
+	static bool IsAnyButtonHeld();
+
 private:
 	// Input events
 	static void SetCallbacks();
 	static void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 	static void ScrollCallback(GLFWwindow* window, double xOffset, double yOffset);
+	static void KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void MouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void CursorPosCallback(GLFWwindow* window, double xPos, double yPos);
+	static void CharCallback(GLFWwindow* window, unsigned int codepoint);
+	static void WindowFocusCallback(GLFWwindow* window, int focused);
+	static void WindowRefreshCallback(GLFWwindow* window);
 	
 	static GLFWwindow* m_WindowID;
 	static float m_ScrollX;
 	static float m_ScrollY;
+	static std::atomic<bool> m_EventPending;
+	static int m_NumButtonsHeld;
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "Query.h"
+
+#include "glad/glad.h"
+
+Query::Query(unsigned int target)
+	: m_Target(target), m_Current(0), m_Pending{ false, false }, m_Result(0)
+{
+	glGenQueries(2, m_IDs);
+}
+
+Query::~Query()
+{
+	glDeleteQueries(2, m_IDs);
+}
+
+void Query::Begin()
+{
+	// the other query may still be in flight, this one was read or never used
+	GetResult();
+	glBeginQuery(m_Target, m_IDs[m_Current]);
+}
+
+void Query::End()
+{
+	glEndQuery(m_Target);
+	m_Pending[m_Current] = true;
+	m_Current = 1 - m_Current;
+}
+
+unsigned long long Query::GetResult()
+{
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		// the older query is the one about to be reused
+		unsigned int id = (m_Current + i) % 2;
+		if (!m_Pending[id])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(m_IDs[id], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available && id != m_Current)
+			continue;
+
+		// a query about to be reused must be read, even if that waits
+		GLuint64 result = 0;
+		glGetQueryObjectui64v(m_IDs[id], GL_QUERY_RESULT, &result);
+		m_Result = result;
+		m_Pending[id] = false;
+	}
+	return m_Result;
+}
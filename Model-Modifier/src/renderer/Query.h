@@ -0,0 +1,23 @@
+#pragma once
+
+// GPU query read back without stalling: two query objects alternate,
+// the result of a frame is picked up once the GPU is done with it, usually a frame later
+class Query
+{
+private:
+	unsigned int m_IDs[2];
+	unsigned int m_Target;
+	unsigned int m_Current;
+	bool m_Pending[2];
+	unsigned long long m_Result;
+
+public:
+	Query(unsigned int target);
+	~Query();
+
+	void Begin();
+	void End();
+
+	// latest available result
+	unsigned long long GetResult();
+};
@@ -0,0 +1,185 @@
+#include "ScreenCapture.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "../external/stb/stb_image_write.h"
+#include "Input.h"
+
+// images held in memory at most, copies in flight included
+static const unsigned int MAX_QUEUED_IMAGES = 8;
+
+ScreenCapture::ScreenCapture()
+	: m_Stopping(false), m_NumQueued(0), m_NumSaved(0)
+{
+	m_Worker = std::thread(&ScreenCapture::Run, this);
+}
+
+ScreenCapture::~ScreenCapture()
+{
+	// images already read back are still saved, the encoder needs no context
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+	m_Condition.notify_all();
+	m_Worker.join();
+}
+
+void ScreenCapture::Shutdown()
+{
+	Poll(true);
+
+	// copies the GPU failed to finish are dropped
+	for (Readback& readback : m_Readbacks)
+	{
+		glDeleteSync(readback.fence);
+		glDeleteBuffers(1, &readback.buffer);
+		std::cout << "Could not read back " << readback.filename << std::endl;
+		m_NumQueued--;
+	}
+	m_Readbacks.clear();
+	if (!m_FreeBuffers.empty())
+		glDeleteBuffers(static_cast<GLsizei>(m_FreeBuffers.size()), m_FreeBuffers.data());
+	m_FreeBuffers.clear();
+}
+
+void ScreenCapture::Capture(const std::string& filename, int width, int height, int format)
+{
+	Readback readback{ filename, width, height, format, 0, nullptr };
+	if (m_FreeBuffers.empty())
+	{
+		glGenBuffers(1, &readback.buffer);
+	}
+	else
+	{
+		readback.buffer = m_FreeBuffers.back();
+		m_FreeBuffers.pop_back();
+	}
+
+	// tightly packed rows, the writers other than PNG take no stride
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, 3 * width * height, nullptr, GL_STREAM_READ);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadBuffer(GL_BACK);
+	// with a pack buffer bound the copy is queued on the GPU, nothing waits here
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_Readbacks.push_back(readback);
+	m_NumQueued++;
+}
+
+void ScreenCapture::Poll(bool wait)
+{
+	// copies finish in submission order, the first unfinished one ends the search
+	while (!m_Readbacks.empty())
+	{
+		Readback& readback = m_Readbacks.front();
+		GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+		// a slow GPU may take longer than one timeout, waiting goes on until the copy is done
+		while (wait && status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(readback.fence, 0, 1000000000);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			return;
+
+		EncodeJob job{ readback.filename, readback.width, readback.height, readback.format, {} };
+		job.pixels.resize(3 * readback.width * readback.height);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, job.pixels.size(), GL_MAP_READ_BIT);
+		if (mapped)
+		{
+			std::memcpy(job.pixels.data(), mapped, job.pixels.size());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		glDeleteSync(readback.fence);
+		m_FreeBuffers.push_back(readback.buffer);
+		m_Readbacks.pop_front();
+
+		if (!mapped)
+		{
+			std::cout << "Could not read back " << job.filename << std::endl;
+			m_NumQueued--;
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Jobs.push_back(std::move(job));
+		}
+		m_Condition.notify_one();
+	}
+}
+
+bool ScreenCapture::IsReading() const
+{
+	return !m_Readbacks.empty();
+}
+
+bool ScreenCapture::CanCapture() const
+{
+	return m_NumQueued < MAX_QUEUED_IMAGES;
+}
+
+unsigned int ScreenCapture::GetNumQueued() const
+{
+	return m_NumQueued;
+}
+
+unsigned int ScreenCapture::GetNumSaved() const
+{
+	return m_NumSaved;
+}
+
+void ScreenCapture::Run()
+{
+	// stb keeps its settings in globals, only this thread writes images
+	stbi_flip_vertically_on_write(true);
+
+	while (true)
+	{
+		EncodeJob job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+			if (m_Jobs.empty())
+				return;
+
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+		}
+
+		if (Encode(job))
+			m_NumSaved++;
+		else
+			std::cout << "Could not save " << job.filename << std::endl;
+
+		m_NumQueued--;
+		Input::PostEvent(); // the idle render loop wakes up to show the saved count
+	}
+}
+
+bool ScreenCapture::Encode(const EncodeJob& job)
+{
+	switch (job.format)
+	{
+	case PNG_FAST_IMAGE:
+		stbi_write_png_compression_level = 1;
+		stbi_write_force_png_filter = 2; // "up", no search over the five filters per row
+		return stbi_write_png((job.filename + ".png").c_str(), job.width, job.height, 3, job.pixels.data(), 3 * job.width) != 0;
+	case TGA_IMAGE:
+		stbi_write_tga_with_rle = 1;
+		return stbi_write_tga((job.filename + ".tga").c_str(), job.width, job.height, 3, job.pixels.data()) != 0;
+	case BMP_IMAGE:
+		return stbi_write_bmp((job.filename + ".bmp").c_str(), job.width, job.height, 3, job.pixels.data()) != 0;
+	default:
+		stbi_write_png_compression_level = 8;
+		stbi_write_force_png_filter = -1;
+		return stbi_write_png((job.filename + ".png").c_str(), job.width, job.height, 3, job.pixels.data(), 3 * job.width) != 0;
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glad/glad.h"
+
+// file formats of saved images, from the smallest files to the fastest encoding
+enum imageFormat
+{
+	PNG_IMAGE = 0,
+	PNG_FAST_IMAGE = 1, // lowest zlib effort and a fixed row filter
+	TGA_IMAGE = 2, // run length encoded
+	BMP_IMAGE = 3 // uncompressed
+};
+
+// screenshots without stalling the frame: the back buffer is copied into a pixel buffer object,
+// mapped a few frames later once its fence has signaled, and encoded on a worker thread
+class ScreenCapture
+{
+public:
+	ScreenCapture();
+	~ScreenCapture();
+
+	// start copying the back buffer, call once the frame is drawn and before swapping
+	// the extension of the saved file is added from the format
+	void Capture(const std::string& filename, int width, int height, int format);
+	// hand the copies the GPU has finished to the encoder, call once per frame
+	// wait blocks until every copy is done
+	void Poll(bool wait = false);
+	// read back the last copies and delete the GL objects, call while the context still exists
+	// the destructor only waits for the encoder
+	void Shutdown();
+
+	// copies the GPU has not finished, Poll() must keep being called
+	bool IsReading() const;
+	// encoder backlog below its limit, a burst waits on this instead of dropping frames
+	bool CanCapture() const;
+	unsigned int GetNumQueued() const;
+	unsigned int GetNumSaved() const;
+
+private:
+	struct Readback
+	{
+		std::string filename;
+		int width;
+		int height;
+		int format;
+		unsigned int buffer;
+		GLsync fence;
+	};
+
+	struct EncodeJob
+	{
+		std::string filename;
+		int width;
+		int height;
+		int format;
+		std::vector<unsigned char> pixels; // tightly packed RGB rows, bottom row first
+	};
+
+	void Run();
+	static bool Encode(const EncodeJob& job);
+
+private:
+	// pixel pack buffers in flight, oldest first, and the ones free for reuse
+	std::deque<Readback> m_Readbacks;
+	std::vector<unsigned int> m_FreeBuffers;
+
+	std::thread m_Worker;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<EncodeJob> m_Jobs; // waiting for the worker
+	bool m_Stopping;
+
+	std::atomic<unsigned int> m_NumQueued; // copies and images not saved yet
+	std::atomic<unsigned int> m_NumSaved;
+};
@@ -1,94 +1,186 @@
 #include "Shader.h"
 
 #include "glad/glad.h"
+#include "GLFW/glfw3.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <vector>
 
-ShaderProgram::ShaderProgram(const std::string &vertexFilepath, const std::string &fragmentFilepath)
+// GL_KHR_parallel_shader_compile and its ARB twin, not part of the glad loader
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+// linked program binaries, one file per sources and driver
+static const std::string SHADER_CACHE_DIRECTORY = "shader_cache";
+
+static std::string ReadSource(const std::string& filepath)
 {
-    std::string vertexSource, fragmentSource;
+    std::ifstream fs(filepath, std::fstream::in);
+    if (!fs)
+        std::cout << "Could not open shader " << filepath << std::endl;
 
-    // Read vertex shader source code from file
+    std::stringstream src;
+    src << fs.rdbuf();
+    return src.str();
+}
+
+// the defines must follow the #version line, which has to stay first
+static void InjectDefines(std::string& source, const ShaderDefines& defines)
+{
+    std::string lines;
+    for (const std::pair<const std::string, int>& define : defines)
     {
-        std::string src;
-        std::string temp;
-        std::ifstream fs;
-        fs.open(vertexFilepath, std::fstream::in);
+        lines += "#define " + define.first + " " + std::to_string(define.second) + "\n";
+    }
 
-        while (std::getline(fs, temp))
-        {
-            src += temp + '\n';
-        }
+    size_t position = 0;
+    size_t version = source.find("#version");
+    if (version != std::string::npos)
+        position = std::min(source.find('\n', version), source.size() - 1) + 1;
+    source.insert(position, lines);
+}
 
-        fs.close();
-        vertexSource = src;
+// 64 bit FNV-1a, unlike std::hash it gives the same key on every run
+static unsigned long long HashString(const std::string& text, unsigned long long hash = 14695981039346656037ull)
+{
+    for (unsigned char c : text)
+    {
+        hash = (hash ^ c) * 1099511628211ull;
     }
+    return hash;
+}
 
-    // Read fragment shader source code from file
+// with the extension, compiling and linking return at once and the driver works on its own threads
+static bool ParallelCompileSupported()
+{
+    static int supported = -1;
+    if (supported < 0)
     {
-        std::string src;
-        std::string temp;
-        std::ifstream fs;
-        fs.open(fragmentFilepath, std::fstream::in);
-
-        while (std::getline(fs, temp))
+        supported = 0;
+        const char* extensions[2][2] = {
+            { "GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR" },
+            { "GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB" }
+        };
+        for (unsigned int i = 0; i < 2 && !supported; i++)
         {
-            src += temp + '\n';
-        }
+            if (!glfwExtensionSupported(extensions[i][0]))
+                continue;
 
-        fs.close();
-        fragmentSource = src;
+            PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress(extensions[i][1]);
+            if (maxShaderCompilerThreads)
+            {
+                maxShaderCompilerThreads(0xFFFFFFFF); // as many threads as the driver wants
+                supported = 1;
+            }
+        }
     }
+    return supported == 1;
+}
 
-    const GLchar *vertexSourceCstr = vertexSource.c_str();
-    const GLchar *fragmentSourceCstr = fragmentSource.c_str();
+static GLuint StartCompile(GLenum type, const std::string& source)
+{
+    const GLchar* sourceCstr = source.c_str();
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &sourceCstr, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
-    // Compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+static void CheckCompile(GLuint shader, const std::string& stage)
+{
+    GLint isCompiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+    if (!isCompiled)
     {
-        glShaderSource(vertexShader, 1, &vertexSourceCstr, NULL);
-        glCompileShader(vertexShader);
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::vector<GLchar> message(std::max(logLength, 1), '\0');
+        glGetShaderInfoLog(shader, logLength, &logLength, message.data());
 
-        GLint isCompiled = GL_FALSE;
-        glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &isCompiled);
-        if (!isCompiled)
-        {
-            GLint logLength = 0;
-            glGetShaderiv(vertexShader, GL_INFO_LOG_LENGTH, &logLength);
-            GLchar *message = (GLchar *)malloc(logLength * sizeof(GLchar));
-            glGetShaderInfoLog(vertexShader, logLength, &logLength, message);
+        std::cout << stage << " shader compilation failed: " << message.data() << std::endl;
+    }
+}
 
-            std::cout << "Vertex shader compilation failed: " << message << std::endl;
-            glDeleteShader(vertexShader);
-        }
+ShaderProgram::ShaderProgram(const std::string &vertexFilepath, const std::string &fragmentFilepath, const ShaderDefines& defines)
+    : m_ID(0), m_VertexShader(0), m_FragmentShader(0), m_Ready(false), m_FromCache(false)
+{
+    std::string vertexSource = ReadSource(vertexFilepath);
+    std::string fragmentSource = ReadSource(fragmentFilepath);
+    InjectDefines(vertexSource, defines);
+    InjectDefines(fragmentSource, defines);
+
+    m_ID = glCreateProgram();
+
+    // a binary only loads on the driver that produced it
+    std::string driver;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const GLubyte* value = glGetString(name);
+        driver += value ? reinterpret_cast<const char*>(value) : "";
     }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", HashString(driver, HashString(fragmentSource, HashString(vertexSource))));
+    m_CachePath = SHADER_CACHE_DIRECTORY + "/" + key + ".bin";
 
-    // Compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    if (LoadBinary())
     {
-        glShaderSource(fragmentShader, 1, &fragmentSourceCstr, NULL);
-        glCompileShader(fragmentShader);
+        CacheUniformLocations();
+        m_Ready = true;
+        m_FromCache = true;
+        return;
+    }
 
-        GLint isCompiled = GL_FALSE;
-        glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &isCompiled);
-        if (!isCompiled)
-        {
-            GLint logLength = 0;
-            glGetShaderiv(fragmentShader, GL_INFO_LOG_LENGTH, &logLength);
-            GLchar *message = (GLchar *)malloc(logLength * sizeof(GLchar));
-            glGetShaderInfoLog(fragmentShader, logLength, &logLength, message);
+    // compile and link are only started, their status is read once the program is needed
+    m_VertexShader = StartCompile(GL_VERTEX_SHADER, vertexSource);
+    m_FragmentShader = StartCompile(GL_FRAGMENT_SHADER, fragmentSource);
+    glAttachShader(m_ID, m_VertexShader);
+    glAttachShader(m_ID, m_FragmentShader);
+    glProgramParameteri(m_ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(m_ID);
+}
 
-            std::cout << "Fragment shader compilation failed: " << message << std::endl;
-            glDeleteShader(fragmentShader);
-        }
+ShaderProgram::~ShaderProgram()
+{
+    glDeleteProgram(m_ID);
+}
+
+bool ShaderProgram::IsReady()
+{
+    if (m_Ready)
+        return true;
+
+    // without the extension the status query below blocks, so the program is finished right away
+    if (ParallelCompileSupported())
+    {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(m_ID, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed)
+            return false;
     }
 
-    // Link shader program
-    m_ID = glCreateProgram();
+    FinishLink();
+    return true;
+}
 
-    glAttachShader(m_ID, vertexShader);
-    glAttachShader(m_ID, fragmentShader);
-    glLinkProgram(m_ID);
+void ShaderProgram::Wait()
+{
+    if (!m_Ready)
+        FinishLink();
+}
+
+bool ShaderProgram::IsFromCache() const
+{
+    return m_FromCache;
+}
+
+void ShaderProgram::FinishLink()
+{
+    CheckCompile(m_VertexShader, "Vertex");
+    CheckCompile(m_FragmentShader, "Fragment");
     glValidateProgram(m_ID);
 
     GLint isLinked;
@@ -102,18 +194,62 @@ ShaderProgram::ShaderProgram(const std::string &vertexFilepath, const std::strin
         std::cout << "Shader linking failed: " << message << std::endl;
         glDeleteProgram(m_ID);
     }
+    else
+    {
+        CacheUniformLocations();
+        SaveBinary();
+    }
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glDeleteShader(m_VertexShader);
+    glDeleteShader(m_FragmentShader);
+    m_Ready = true;
 }
 
-ShaderProgram::~ShaderProgram()
+bool ShaderProgram::LoadBinary()
 {
-    glDeleteProgram(m_ID);
+    std::ifstream file(m_CachePath, std::ios::binary);
+    if (!file)
+        return false;
+
+    GLenum format = 0;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return false;
+
+    // a driver update may still reject it, the sources are then compiled again and the file replaced
+    glProgramBinary(m_ID, format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(m_ID, GL_LINK_STATUS, &isLinked);
+    return isLinked == GL_TRUE;
+}
+
+void ShaderProgram::SaveBinary() const
+{
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    GLint length = 0;
+    glGetProgramiv(m_ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (numFormats == 0 || length <= 0)
+        return;
+
+    GLenum format = 0;
+    std::vector<char> binary(length);
+    glGetProgramBinary(m_ID, length, NULL, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+    std::ofstream file(m_CachePath, std::ios::binary);
+    if (!file)
+        return;
+    file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+    file.write(binary.data(), binary.size());
 }
 
-void ShaderProgram::Bind() const
+void ShaderProgram::Bind()
 {
+    // a program still compiling is waited for
+    Wait();
     glUseProgram(m_ID);
 }
 
@@ -163,7 +299,51 @@ void ShaderProgram::SetUniformMat4f(const std::string &name, const glm::mat4 &va
     glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, &value[0][0]);
 }
 
+void ShaderProgram::CacheUniformLocations()
+{
+    GLint numUniforms = 0;
+    glGetProgramiv(m_ID, GL_ACTIVE_UNIFORMS, &numUniforms);
+    for (GLint i = 0; i < numUniforms; i++)
+    {
+        GLchar name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(m_ID, i, sizeof(name), &length, &size, &type, name);
+
+        // members of uniform blocks have no location, they are set through their buffer
+        GLint location = glGetUniformLocation(m_ID, name);
+        if (location < 0)
+            continue;
+
+        std::string uniformName(name, length);
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            uniformName.resize(uniformName.size() - 3);
+        m_UniformLocations[uniformName] = location;
+    }
+}
+
 GLint ShaderProgram::GetUniformLocation(const std::string &name) const
 {
-    return glGetUniformLocation(m_ID, name.c_str());
+    // like glGetUniformLocation, unknown names give -1 and the glUniform call is ignored
+    auto search = m_UniformLocations.find(name);
+    return search != m_UniformLocations.end() ? search->second : -1;
+}
+
+ShaderPermutations::ShaderPermutations(const std::string& vertexFilepath, const std::string& fragmentFilepath)
+    : m_VertexFilepath(vertexFilepath), m_FragmentFilepath(fragmentFilepath)
+{
+}
+
+ShaderProgram& ShaderPermutations::Get(const ShaderDefines& defines)
+{
+    std::unique_ptr<ShaderProgram>& program = m_Programs[defines];
+    if (!program)
+        program = std::make_unique<ShaderProgram>(m_VertexFilepath, m_FragmentFilepath, defines);
+    return *program;
+}
+
+unsigned int ShaderPermutations::GetNumPrograms() const
+{
+    return static_cast<unsigned int>(m_Programs.size());
 }
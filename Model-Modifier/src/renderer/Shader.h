@@ -1,17 +1,29 @@
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "glad/glad.h"
 #include "../external/glm/glm.hpp"
 
+// compile time switches of a program, each one becomes "#define name value" right after the #version line
+typedef std::map<std::string, int> ShaderDefines;
+
 class ShaderProgram
 {
 public:
-	ShaderProgram(const std::string &vertexFilepath, const std::string &fragmentFilepath);
+	// loads the linked binary from the disk cache, or starts compiling and linking without waiting for them
+	ShaderProgram(const std::string &vertexFilepath, const std::string &fragmentFilepath, const ShaderDefines& defines = ShaderDefines());
 	~ShaderProgram();
 
-	void Bind() const;
+	// true once linked, never waits when the driver compiles in parallel
+	bool IsReady();
+	void Wait();
+	bool IsFromCache() const;
+
+	void Bind();
 	void Unbind() const;
 
 	GLuint GetID() const;
@@ -25,8 +37,36 @@ public:
 	void SetUniformMat4f(const std::string& name, const glm::mat4& matrix) const;
 private:
 
+	void FinishLink();
+	bool LoadBinary();
+	void SaveBinary() const;
+
+	// locations are resolved once after linking, arrays are found by their base name
+	void CacheUniformLocations();
 	GLint GetUniformLocation(const std::string &name) const;
 
 private:
 	GLuint m_ID;
-};
\ No newline at end of file
+	GLuint m_VertexShader;
+	GLuint m_FragmentShader;
+	bool m_Ready;
+	bool m_FromCache;
+	std::string m_CachePath;
+	std::unordered_map<std::string, GLint> m_UniformLocations;
+};
+
+// every permutation of one pair of shader files, compiled the first time its defines are requested
+// constant light counts unroll the loops and constant switches remove the branches they guard
+class ShaderPermutations
+{
+public:
+	ShaderPermutations(const std::string& vertexFilepath, const std::string& fragmentFilepath);
+
+	ShaderProgram& Get(const ShaderDefines& defines);
+	unsigned int GetNumPrograms() const;
+
+private:
+	std::string m_VertexFilepath;
+	std::string m_FragmentFilepath;
+	std::map<ShaderDefines, std::unique_ptr<ShaderProgram>> m_Programs;
+};
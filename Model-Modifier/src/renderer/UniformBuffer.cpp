@@ -0,0 +1,42 @@
+#include "UniformBuffer.h"
+
+#include <cstring>
+
+#include "glad/glad.h"
+
+UniformBuffer::UniformBuffer(unsigned int size, unsigned int binding)
+	: m_Binding(binding)
+{
+	glGenBuffers(1, &m_ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	Bind();
+}
+
+UniformBuffer::~UniformBuffer()
+{
+	glDeleteBuffers(1, &m_ID);
+}
+
+bool UniformBuffer::AssignData(const void* data, unsigned int size)
+{
+	if (m_Uploaded.size() == size && std::memcmp(m_Uploaded.data(), data, size) == 0)
+		return false;
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	m_Uploaded.assign(bytes, bytes + size);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	return true;
+}
+
+void UniformBuffer::Bind() const
+{
+	glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_ID);
+}
+
+unsigned int UniformBuffer::GetBinding() const
+{
+	return m_Binding;
+}
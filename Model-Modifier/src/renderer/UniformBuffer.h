@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "../external/glm/glm.hpp"
+
+// binding points of the uniform blocks declared by the shaders in res/shaders
+enum uniformBinding
+{
+	TRANSFORM_BINDING = 0,
+	LIGHT_BINDING = 1,
+	MATERIAL_BINDING = 2
+};
+
+// binding points of the shader storage buffers holding the clustered lights
+enum storageBinding
+{
+	LIGHT_STORAGE_BINDING = 0,
+	CLUSTER_STORAGE_BINDING = 1,
+	LIGHT_INDEX_STORAGE_BINDING = 2
+};
+
+// std140 mirrors of the shader blocks, a vec3 followed by a float shares one 16 byte slot
+struct TransformBlock
+{
+	glm::mat4 model;
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 normal; // transpose(inverse(model))
+};
+
+struct ClusterBlock
+{
+	glm::uvec4 grid; // tiles along x and y, depth slices, number of lights
+	glm::vec4 params; // viewport width and height, near and far planes
+	glm::uvec4 counts; // lights reaching everything, listed first and in no cluster, then 1 when the clusters are not built
+};
+
+struct MaterialBlock
+{
+	glm::vec3 ambient;
+	float shine;
+	glm::vec3 diffuse;
+	float metallic;
+	glm::vec3 specular;
+	float roughness;
+	glm::vec3 warm;
+	float alpha;
+	glm::vec3 cool;
+	float beta;
+};
+
+static_assert(sizeof(TransformBlock) == 256, "TransformBlock does not match the std140 layout");
+static_assert(sizeof(ClusterBlock) == 48, "ClusterBlock does not match the std140 layout");
+static_assert(sizeof(MaterialBlock) == 80, "MaterialBlock does not match the std140 layout");
+
+// storage of one uniform block, bound once to its binding point so every program declaring the block reads it
+// data is only sent when it differs from the last upload, switching programs re-uploads nothing
+class UniformBuffer
+{
+private:
+	unsigned int m_ID;
+	unsigned int m_Binding;
+	std::vector<unsigned char> m_Uploaded; // copy of the data last sent
+
+public:
+	UniformBuffer(unsigned int size, unsigned int binding);
+	~UniformBuffer();
+
+	// returns true when the data changed and was uploaded
+	bool AssignData(const void* data, unsigned int size);
+
+	void Bind() const;
+	unsigned int GetBinding() const;
+};
@@ -18,7 +18,8 @@ void VertexArray::AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& la
 	vb.Bind();
 
 	const auto& elements = layout.GetElements();
-	unsigned int offset = 0;
+	// streamed buffers move their data between regions, the attributes follow it
+	unsigned int offset = vb.GetOffset();
 
 	for (unsigned int i = 0; i < elements.size(); i++)
 	{
@@ -27,7 +28,7 @@ void VertexArray::AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& la
 		glEnableVertexAttribArray(i);
 		glVertexAttribPointer(i, element.count, element.type,
 			element.normalized, layout.GetStride(), (const void*)(static_cast<intptr_t>(offset)));
-		offset += element.count * VertexBufferElement::GetSizeOfType(element.type);
+		offset += VertexBufferElement::GetSizeOfElement(element);
 	}
 }
 
@@ -1,51 +1,51 @@
 #include "VertexBuffer.h"
 
-#include <iostream>
-#include "glad/glad.h"
-
 VertexBuffer::VertexBuffer(const void *data, unsigned int size, DRAW_MODE mode)
+	: m_Buffer(GL_ARRAY_BUFFER)
 {
-	glGenBuffers(1, &m_ID);
 	AssignData(data, size, mode);
-
-	int bufferSize;
-	glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &bufferSize);
-	if (size != bufferSize)
-	{
-		glDeleteBuffers(1, &m_ID);
-		std::cout << "Buffer error." << std::endl;
-	}
 }
 
 VertexBuffer::~VertexBuffer()
 {
-	glDeleteBuffers(1, &m_ID);
 }
 
-void VertexBuffer::AssignData(const void* data, unsigned int size, DRAW_MODE mode) const
+void VertexBuffer::AssignData(const void* data, unsigned int size, DRAW_MODE mode)
+{
+	m_Buffer.Assign(data, size, mode);
+}
+
+void VertexBuffer::AssignSubData(const void* data, unsigned int offset, unsigned int size) const
 {
-	glBindBuffer(GL_ARRAY_BUFFER, m_ID);
-	if (mode == DRAW_MODE::STATIC)
-	{
-		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-	}
-	else if (mode == DRAW_MODE::DYNAMIC)
-	{
-		glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
-	}
-	else
-	{
-		glDeleteBuffers(1, &m_ID);
-		std::cout << "Buffer mode error." << std::endl;
-	}
+	m_Buffer.AssignSub(data, offset, size);
+}
+
+void* VertexBuffer::MapRegion(unsigned int size)
+{
+	return m_Buffer.MapRegion(size);
 }
 
 void VertexBuffer::Bind() const
 {
-	glBindBuffer(GL_ARRAY_BUFFER, m_ID);
+	m_Buffer.Bind();
 }
 
 void VertexBuffer::Unbind() const
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-}
\ No newline at end of file
+	m_Buffer.Unbind();
+}
+
+unsigned int VertexBuffer::GetSize() const
+{
+	return m_Buffer.GetSize();
+}
+
+unsigned int VertexBuffer::GetCapacity() const
+{
+	return m_Buffer.GetCapacity();
+}
+
+unsigned int VertexBuffer::GetOffset() const
+{
+	return m_Buffer.GetOffset();
+}
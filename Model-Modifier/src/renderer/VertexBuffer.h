@@ -1,20 +1,28 @@
 #pragma once
 
-enum class DRAW_MODE {
-	STATIC, DYNAMIC
-};
+#include "GrowableBuffer.h"
 
 class VertexBuffer
 {
 private:
-	unsigned int m_ID;
+	GrowableBuffer m_Buffer;
 
 public:
 	VertexBuffer(const void *data, unsigned int size, DRAW_MODE mode);
 	~VertexBuffer();
 
-	void AssignData(const void* data, unsigned int size, DRAW_MODE mode) const;
+	// reuses the storage when the data fits, a streamed buffer moves to its next region
+	void AssignData(const void* data, unsigned int size, DRAW_MODE mode);
+	// overwrite size bytes at offset, the storage keeps its size
+	void AssignSubData(const void* data, unsigned int offset, unsigned int size) const;
+	// streamed buffers only, size bytes of mapped memory to write the next vertices to directly
+	void* MapRegion(unsigned int size);
 
 	void Bind() const;
 	void Unbind() const;
-};
\ No newline at end of file
+
+	unsigned int GetSize() const;
+	unsigned int GetCapacity() const;
+	// where the current vertices start, vertex arrays add it to their attribute offsets
+	unsigned int GetOffset() const;
+};
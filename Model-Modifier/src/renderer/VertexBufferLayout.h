@@ -4,6 +4,18 @@
 
 #include "glad/glad.h"
 
+// 16 bit float, only used to pick the attribute type
+struct HalfFloat
+{
+	unsigned short bits;
+};
+
+// signed normalized x, y, z on 10 bits and w on 2 bits in one integer, read as a vec4
+struct PackedInt2_10_10_10
+{
+	unsigned int bits;
+};
+
 struct VertexBufferElement
 {
 	unsigned int type;
@@ -17,9 +29,19 @@ struct VertexBufferElement
 		case GL_FLOAT: return 4;
 		case GL_UNSIGNED_INT: return 4;
 		case GL_UNSIGNED_BYTE: return 1;
+		case GL_SHORT: return 2;
+		case GL_HALF_FLOAT: return 2;
 		}
 		return 0;
 	}
+
+	// packed types hold every component in one integer
+	static unsigned int GetSizeOfElement(const VertexBufferElement& element)
+	{
+		if (element.type == GL_INT_2_10_10_10_REV)
+			return 4;
+		return element.count * GetSizeOfType(element.type);
+	}
 };
 
 class VertexBufferLayout
@@ -57,6 +79,30 @@ public:
 		m_Stride += count * VertexBufferElement::GetSizeOfType(GL_UNSIGNED_BYTE);
 	}
 
+	// 16 bit integers mapped to [-1, 1]
+	template<>
+	void Push<short>(unsigned int count)
+	{
+		m_Elements.push_back({ GL_SHORT, count, GL_TRUE });
+		m_Stride += VertexBufferElement::GetSizeOfElement(m_Elements.back());
+	}
+
+	template<>
+	void Push<HalfFloat>(unsigned int count)
+	{
+		m_Elements.push_back({ GL_HALF_FLOAT, count, GL_FALSE });
+		m_Stride += VertexBufferElement::GetSizeOfElement(m_Elements.back());
+	}
+
+	// count is the number of components read by the shader, GL accepts only 4 for this type
+	// the element is one 32 bit word whatever the count
+	template<>
+	void Push<PackedInt2_10_10_10>(unsigned int count)
+	{
+		m_Elements.push_back({ GL_INT_2_10_10_10_REV, count, GL_TRUE });
+		m_Stride += VertexBufferElement::GetSizeOfElement(m_Elements.back());
+	}
+
 	inline const std::vector<VertexBufferElement> GetElements() const { return m_Elements; }
 	inline unsigned int GetStride() const { return m_Stride; }
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "GeometryJobs.h"
+
+#include "../renderer/Input.h"
+
+GeometryJobs::GeometryJobs()
+    : m_Stopping(false), m_NextID(1), m_NumUnfinished(0)
+{
+    m_Worker = std::thread(&GeometryJobs::Run, this);
+}
+
+GeometryJobs::~GeometryJobs()
+{
+    // queued jobs are dropped, a running one stops at its next cancellation check
+    Cancel();
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Condition.notify_all();
+    m_Worker.join();
+}
+
+unsigned int GeometryJobs::Submit(const std::string& name, const Object& obj, GeometryWork work, int shading, int format, bool viewOrders)
+{
+    unsigned int id;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        id = m_NextID++;
+        m_Jobs.push_back({ id, name, obj, work, shading, format, viewOrders, std::make_shared<Progress>() });
+        if (m_Jobs.size() == 1 && m_CurrentName.empty())
+            m_CurrentName = name;
+        m_NumUnfinished++; // counted under the lock, Cancel() takes dropped jobs off it
+    }
+    m_Condition.notify_one();
+    return id;
+}
+
+std::vector<std::unique_ptr<GeometryResult>> GeometryJobs::Collect()
+{
+    if (m_Results.Empty())
+        return {};
+    return m_Results.PopAll();
+}
+
+void GeometryJobs::Cancel()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_NumUnfinished -= static_cast<unsigned int>(m_Jobs.size());
+    m_Jobs.clear();
+    if (m_CurrentProgress)
+        m_CurrentProgress->Cancel();
+    else
+        m_CurrentName.clear();
+}
+
+bool GeometryJobs::IsBusy() const
+{
+    return m_NumUnfinished > 0;
+}
+
+std::string GeometryJobs::GetCurrentName() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_CurrentName;
+}
+
+std::shared_ptr<const Progress> GeometryJobs::GetCurrentProgress() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_CurrentProgress;
+}
+
+void GeometryJobs::Run()
+{
+    while (true)
+    {
+        GeometryJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+            if (m_Stopping)
+                return;
+
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_CurrentName = job.name;
+            m_CurrentProgress = job.progress;
+        }
+
+        std::unique_ptr<GeometryResult> result = std::make_unique<GeometryResult>();
+        result->id = job.id;
+        result->progress = job.progress.get();
+        result->obj = std::move(job.obj);
+        job.work(*result);
+
+        // normals, index optimization and packing are done here too, only the upload is left
+        bool cancelled = job.progress->IsCancelled();
+        if (result->changed && !cancelled)
+        {
+            job.progress->BeginStage("Building the mesh", 0);
+            result->mesh = std::make_unique<Mesh>(result->obj, job.shading, job.format);
+            if (!result->reservedAdjacency.empty())
+                result->mesh->ReserveAdjacency(std::move(result->reservedAdjacency));
+            result->mesh->SetViewOrders(job.viewOrders);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_CurrentName = m_Jobs.empty() ? std::string() : m_Jobs.front().name;
+            m_CurrentProgress.reset();
+        }
+        // whatever the cancelled work built is released here, the model it started from is untouched
+        if (cancelled)
+            result.reset();
+        else
+            m_Results.Push(std::move(result));
+        m_NumUnfinished--;
+        Input::PostEvent(); // the idle render loop wakes up to take the result
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mesh.h"
+#include "object/Object.h"
+#include "surface/ProgressiveMesh.h"
+#include "util/MPSCQueue.h"
+#include "util/Progress.h"
+
+// output of a geometry job, everything in it is built on the worker
+struct GeometryResult
+{
+	unsigned int id = 0;
+	Progress* progress = nullptr; // handed to the Surface of the work, cancelled from the render thread
+	Object obj; // starts as a copy of the submitted object, the work replaces it by the modified one
+	bool changed = true; // cleared by work that only derives data from the object, no mesh is built then
+	std::unique_ptr<Mesh> mesh; // CPU buffers of the modified object, the render thread only uploads them
+	ProgressiveMesh progressiveMesh; // recorded collapses, progressive mesh jobs only
+	std::vector<glm::uvec2> reservedAdjacency; // vertex-face pairs later edits of the mesh create, reserved in it
+};
+
+typedef std::function<void(GeometryResult&)> GeometryWork;
+
+// modifications of the model run on a worker thread instead of inside the UI frame
+// jobs run one at a time in submission order, each one on the object it was submitted with
+// results come back through a lock-free queue, the render thread collects them once per frame
+class GeometryJobs
+{
+public:
+	GeometryJobs();
+	~GeometryJobs();
+
+	// run work on a copy of obj, then build the mesh of the result with the given settings
+	// returns the id of the job, found again in its result
+	unsigned int Submit(const std::string& name, const Object& obj, GeometryWork work, int shading, int format, bool viewOrders);
+	// results finished since the last call, oldest first
+	std::vector<std::unique_ptr<GeometryResult>> Collect();
+	// drop the queued jobs and stop the running one, cancelled jobs never return a result
+	void Cancel();
+
+	// jobs queued or running
+	bool IsBusy() const;
+	// job running on the worker, or the next one to run
+	std::string GetCurrentName() const;
+	// progress of the running job, nullptr between jobs
+	std::shared_ptr<const Progress> GetCurrentProgress() const;
+
+private:
+	struct GeometryJob
+	{
+		unsigned int id;
+		std::string name;
+		Object obj;
+		GeometryWork work;
+		int shading;
+		int format;
+		bool viewOrders;
+		std::shared_ptr<Progress> progress;
+	};
+
+	void Run();
+
+private:
+	std::thread m_Worker;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<GeometryJob> m_Jobs; // waiting for the worker
+	std::string m_CurrentName;
+	std::shared_ptr<Progress> m_CurrentProgress;
+	bool m_Stopping;
+	unsigned int m_NextID;
+
+	std::atomic<unsigned int> m_NumUnfinished;
+	MPSCQueue<std::unique_ptr<GeometryResult>> m_Results;
+};
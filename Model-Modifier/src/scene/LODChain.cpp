@@ -0,0 +1,303 @@
+#include "LODChain.h"
+
+#include <cmath>
+
+#include "surface/Surface.h"
+#include "../renderer/Input.h"
+
+LODChain::LODChain()
+    : m_Uploaded(false), m_Shading(FLAT), m_Radius(0.0f)
+{
+}
+
+LODChain::~LODChain()
+{
+    Clear();
+}
+
+void LODChain::Generate(const Object& obj, int shading, bool halfEdge, std::vector<unsigned int> meshVertices)
+{
+    Clear();
+
+    m_Shading = shading;
+    for (glm::vec3 vertPos : obj.m_VertexPos)
+    {
+        m_Radius = std::max(m_Radius, glm::length(vertPos));
+    }
+
+    // the worker owns a copy of the object, the build outlives it since it is joined first
+    m_Build = std::make_unique<LODBuild>();
+    m_Build->halfEdge = halfEdge;
+    m_Build->meshVertices = std::move(meshVertices);
+    if (halfEdge)
+        m_Worker = std::thread(BuildHalfEdgeLevels, m_Build.get(), obj, m_Ratios);
+    else
+        m_Worker = std::thread(BuildLevels, m_Build.get(), obj, shading, m_Ratios);
+}
+
+void LODChain::Clear()
+{
+    // a running job stops at its next cancellation check, so joining it only waits for the current step
+    if (m_Worker.joinable())
+    {
+        m_Build->progress.Cancel();
+        m_Worker.join();
+    }
+
+    if (m_Build && m_Uploaded)
+        ReleaseBuffers();
+    m_Build.reset();
+    m_Uploaded = false;
+    m_Radius = 0.0f;
+}
+
+void LODChain::BuildLevels(LODBuild* build, Object obj, int shading, std::vector<float> ratios)
+{
+    obj.MakeTriangleMesh();
+    unsigned int originalCount = static_cast<unsigned int>(obj.m_TriFaceIndices.size());
+
+    std::vector<unsigned int> counts;
+    for (float ratio : ratios)
+    {
+        counts.push_back(static_cast<unsigned int>(originalCount * ratio));
+    }
+
+    // a single run emits every level, their errors are measured against the original surface
+    Surface GH(obj, &build->progress);
+    std::vector<Object> simplified = GH.QEM(counts);
+
+    for (unsigned int i = 0; i < simplified.size(); i++)
+    {
+        if (build->progress.IsCancelled())
+            return;
+
+        LODLevel level;
+        level.error = std::sqrt(std::max(GH.m_SnapshotErrors[i], 0.0f));
+        level.numFaces = static_cast<unsigned int>(simplified[i].m_TriFaceIndices.size());
+        level.mesh = std::make_unique<Mesh>(simplified[i], shading);
+        build->levels.push_back(std::move(level));
+    }
+
+    build->done = true;
+    Input::PostEvent(); // the idle render loop wakes up to upload the levels
+}
+
+void LODChain::BuildHalfEdgeLevels(LODBuild* build, Object obj, std::vector<float> ratios)
+{
+    obj.MakeTriangleMesh();
+    unsigned int originalCount = static_cast<unsigned int>(obj.m_TriFaceIndices.size());
+
+    // one recording of half-edge collapses serves every level, vertices keep their original index
+    Surface PM(obj, &build->progress);
+    ProgressiveMesh progressiveMesh = PM.BuildProgressiveMesh(true);
+    if (build->progress.IsCancelled())
+        return;
+    build->vertexPos = obj.m_VertexPos;
+
+    for (float ratio : ratios)
+    {
+        if (build->progress.IsCancelled())
+            return;
+
+        progressiveMesh.SetFaceCount(static_cast<unsigned int>(originalCount * ratio));
+
+        LODLevel level;
+        level.error = std::sqrt(std::max(progressiveMesh.GetError(), 0.0f));
+        level.numFaces = progressiveMesh.GetFaceCount();
+        level.indices = progressiveMesh.GetIndices();
+        OptimizeVertexCache(level.indices.data(), static_cast<unsigned int>(level.indices.size()), static_cast<unsigned int>(obj.m_VertexPos.size()));
+        build->levels.push_back(std::move(level));
+    }
+
+    build->done = true;
+    Input::PostEvent(); // the idle render loop wakes up to upload the levels
+}
+
+void LODChain::BuildLevelMeshes(LODBuild* build, int shading)
+{
+    for (LODLevel& level : build->levels)
+    {
+        if (build->progress.IsCancelled())
+            return;
+
+        // half-edge levels only keep indices, mixed shading needs its own fan vertices
+        if (!level.mesh)
+        {
+            Object levelObj;
+            levelObj.m_VertexPos = build->vertexPos;
+            for (unsigned int i = 0; i < level.indices.size(); i += 3)
+            {
+                levelObj.m_TriFaceIndices.push_back({ level.indices[i], level.indices[i + 1], level.indices[i + 2] });
+            }
+            level.mesh = std::make_unique<Mesh>(levelObj, shading);
+        }
+        else
+        {
+            level.mesh->Rebuild(shading);
+        }
+    }
+
+    build->done = true;
+    Input::PostEvent(); // the idle render loop wakes up to upload the levels
+}
+
+bool LODChain::Poll(const Mesh& mesh, const VertexBufferLayout& layout)
+{
+    if (!m_Build || m_Uploaded || !m_Build->done)
+        return false;
+
+    // the vertex order of the drawn buffers is only known once they are built
+    if (IsShared() && !mesh.IsCached(m_Shading))
+        return false;
+
+    // shading changed since the levels were built, the worker builds them again meanwhile the full mesh is drawn
+    if (!IsShared() && !HasLevelMeshes())
+    {
+        if (m_Worker.joinable())
+            m_Worker.join(); // already done
+        m_Build->done = false;
+        m_Worker = std::thread(BuildLevelMeshes, m_Build.get(), m_Shading);
+        return false;
+    }
+
+    Upload(mesh, layout);
+    m_Uploaded = true;
+
+    return true;
+}
+
+void LODChain::Rebuild(int shading)
+{
+    // flat and smooth levels draw from the same buffers
+    bool sameBuffers = BufferShading(shading) == BufferShading(m_Shading);
+    m_Shading = shading;
+    if (sameBuffers)
+        return;
+
+    if (m_Uploaded)
+    {
+        ReleaseBuffers();
+        m_Uploaded = false;
+    }
+}
+
+bool LODChain::HasLevelMeshes() const
+{
+    for (const LODLevel& level : m_Build->levels)
+    {
+        if (!level.mesh || BufferShading(level.mesh->m_ShadingType) != BufferShading(m_Shading))
+            return false;
+    }
+    return true;
+}
+
+void LODChain::Upload(const Mesh& mesh, const VertexBufferLayout& layout)
+{
+    if (IsShared())
+    {
+        // levels draw from the vertex buffer of the mesh, their indices follow its renumbered vertices,
+        // which only change with the topology and the chain is dropped then
+        const std::vector<unsigned int>& meshVertices = m_Build->meshVertices;
+        const std::vector<unsigned int>& vertexRemap = mesh.m_Cached[BufferShading(m_Shading)].vertexRemap;
+
+        // creating an index buffer binds it to the bound vertex array
+        glBindVertexArray(0);
+        std::vector<unsigned int> indices;
+        for (LODLevel& level : m_Build->levels)
+        {
+            indices.resize(level.indices.size());
+            for (unsigned int i = 0; i < level.indices.size(); i++)
+            {
+                unsigned int vertIdx = meshVertices.empty() ? level.indices[i] : meshVertices[level.indices[i]];
+                indices[i] = vertexRemap.empty() ? vertIdx : vertexRemap[vertIdx];
+            }
+            level.indexBuffer = std::make_unique<IndexBuffer>(indices.data(), static_cast<unsigned int>(indices.size()), DRAW_MODE::STATIC);
+        }
+        return;
+    }
+
+    // the CPU buffers were built on the worker, only the upload is left
+    for (LODLevel& level : m_Build->levels)
+    {
+        level.vertexArray = std::make_unique<VertexArray>();
+        level.vertexBuffer = std::make_unique<VertexBuffer>(level.mesh->m_OutVertices, level.mesh->m_OutNumVert * sizeof(float), DRAW_MODE::STATIC);
+        level.vertexArray->AddBuffer(*level.vertexBuffer, layout);
+        level.indexBuffer = std::make_unique<IndexBuffer>(level.mesh->m_OutIndices, level.mesh->m_OutNumIdx, DRAW_MODE::STATIC);
+    }
+}
+
+void LODChain::ReleaseBuffers()
+{
+    for (LODLevel& level : m_Build->levels)
+    {
+        level.indexBuffer.reset();
+        level.vertexBuffer.reset();
+        level.vertexArray.reset();
+    }
+}
+
+int LODChain::SelectLevel(float distance, float fovY, float screenHeight, float pixelThreshold) const
+{
+    if (!IsReady())
+        return -1;
+
+    // distance to the closest point of the bounding sphere, kept in front of the near plane
+    float nearestDist = std::max(distance - m_Radius, 0.1f);
+    float pixelsPerUnit = screenHeight / (2.0f * nearestDist * std::tan(fovY / 2.0f));
+
+    // levels go from finest to coarsest, with growing error
+    int selected = -1;
+    for (unsigned int i = 0; i < m_Build->levels.size(); i++)
+    {
+        if (m_Build->levels[i].error * pixelsPerUnit > pixelThreshold)
+            break;
+        selected = static_cast<int>(i);
+    }
+    return selected;
+}
+
+bool LODChain::IsReady() const
+{
+    return m_Build && m_Uploaded;
+}
+
+bool LODChain::IsBuilding() const
+{
+    return m_Build && !m_Build->done;
+}
+
+bool LODChain::IsShared() const
+{
+    return m_Build && m_Build->halfEdge && (m_Shading == SMOOTH || m_Shading == FLAT);
+}
+
+unsigned int LODChain::GetNumLevels() const
+{
+    return IsReady() ? static_cast<unsigned int>(m_Build->levels.size()) : 0;
+}
+
+unsigned int LODChain::GetNumFaces(unsigned int level) const
+{
+    return m_Build->levels[level].numFaces;
+}
+
+void LODChain::Bind(unsigned int level) const
+{
+    // the vertex array records the index buffer binding, switching level only swaps it
+    if (IsShared())
+    {
+        m_Build->levels[level].indexBuffer->Bind();
+        return;
+    }
+    m_Build->levels[level].vertexArray->Bind();
+}
+
+unsigned int LODChain::GetCount(unsigned int level) const
+{
+    return m_Build->levels[level].indexBuffer->GetCount();
+}
+
+unsigned int LODChain::GetIndexType(unsigned int level) const
+{
+    return m_Build->levels[level].indexBuffer->GetType();
+}
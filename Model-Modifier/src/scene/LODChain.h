@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../renderer/VertexArray.h"
+#include "../renderer/VertexBuffer.h"
+#include "../renderer/IndexBuffer.h"
+#include "../renderer/VertexBufferLayout.h"
+
+#include "Mesh.h"
+#include "object/Object.h"
+#include "util/Progress.h"
+
+struct LODLevel
+{
+	float error; // geometric error bound, in object space
+	unsigned int numFaces;
+	std::unique_ptr<Mesh> mesh; // CPU buffers, built on the worker thread
+	std::vector<unsigned int> indices; // half-edge levels only, triangles indexing the original vertices
+
+	// GPU buffers, only created on the render thread
+	std::unique_ptr<VertexArray> vertexArray;
+	std::unique_ptr<VertexBuffer> vertexBuffer;
+	std::unique_ptr<IndexBuffer> indexBuffer;
+};
+
+// levels of one background job, the render thread only reads them once done is set
+struct LODBuild
+{
+	std::atomic<bool> done{ false };
+	Progress progress; // cancelled when the chain drops the build, the worker stops at its next check
+	std::vector<LODLevel> levels;
+
+	// half-edge levels never move vertices, with flat and smooth shading they index the vertex buffer the object is drawn with
+	bool halfEdge = false;
+	std::vector<glm::vec3> vertexPos; // vertices the indices refer to, mixed shading builds its own buffers from them
+	std::vector<unsigned int> meshVertices; // vertex of the drawn mesh for each of them, empty when they are the same
+};
+
+class LODChain
+{
+public:
+	LODChain();
+	~LODChain();
+
+	// start simplifying obj into the chain of levels on a background thread
+	// halfEdge levels only have index buffers into the vertices of the drawn mesh,
+	// meshVertices gives the mesh vertex of every vertex of obj when obj is a compacted copy of it
+	void Generate(const Object& obj, int shading, bool halfEdge = false, std::vector<unsigned int> meshVertices = {});
+	void Clear();
+
+	// upload the levels once the job is done, returns true on the frame they become available
+	// levels built for another shading are first built again on the worker,
+	// shared levels wait for the buffers of mesh in the current shading
+	bool Poll(const Mesh& mesh, const VertexBufferLayout& layout);
+	// the levels are unavailable until Poll has them in the new shading
+	void Rebuild(int shading);
+
+	// coarsest level whose projected error stays below pixelThreshold, -1 for the full mesh
+	int SelectLevel(float distance, float fovY, float screenHeight, float pixelThreshold) const;
+
+	bool IsReady() const;
+	bool IsBuilding() const;
+	bool IsShared() const;
+	unsigned int GetNumLevels() const;
+	unsigned int GetNumFaces(unsigned int level) const;
+
+	// shared levels only bind their index buffer, the vertex array of the drawn mesh must be bound
+	void Bind(unsigned int level) const;
+	unsigned int GetCount(unsigned int level) const;
+	unsigned int GetIndexType(unsigned int level) const;
+
+private:
+	static void BuildLevels(LODBuild* build, Object obj, int shading, std::vector<float> ratios);
+	static void BuildHalfEdgeLevels(LODBuild* build, Object obj, std::vector<float> ratios);
+	// buffers of every level in shading, half-edge levels get their own mesh the first time
+	static void BuildLevelMeshes(LODBuild* build, int shading);
+
+	// every level has its buffers in the current shading
+	bool HasLevelMeshes() const;
+	void Upload(const Mesh& mesh, const VertexBufferLayout& layout);
+	void ReleaseBuffers();
+
+private:
+	// fraction of the original triangle count kept by each level
+	std::vector<float> m_Ratios{ 0.5f, 0.25f, 0.125f, 0.0625f };
+
+	std::unique_ptr<LODBuild> m_Build;
+	std::thread m_Worker; // builds m_Build, joined before the build is dropped
+	bool m_Uploaded;
+
+	int m_Shading;
+	float m_Radius; // bounding radius of the model around the origin
+};
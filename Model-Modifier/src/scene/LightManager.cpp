@@ -0,0 +1,226 @@
+#include "LightManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "util/ParallelFor.h"
+
+LightManager::LightManager()
+    : m_NumCameraLights(3), m_Clustered(true), m_NumGlobalLights(0), m_FovY(0.0f), m_Aspect(0.0f), m_Near(0.0f), m_Far(0.0f),
+      m_LightBuffer(GL_SHADER_STORAGE_BUFFER), m_ClusterBuffer(GL_SHADER_STORAGE_BUFFER), m_IndexBuffer(GL_SHADER_STORAGE_BUFFER)
+{
+    // the three original camera lights, they reach everything
+    m_Lights = {
+        { glm::vec3(-10, 5, 0), 0.0f, glm::vec3(0.498f, 0.522f, 0.333f), 1.0f, true, true }, // top left, olive
+        { glm::vec3(10, 5, 0), 0.0f, glm::vec3(1.0f, 0.466f, 1.0f), 2.0f, false, true }, // top right, pink
+        { glm::vec3(0, -10, 0), 0.0f, glm::vec3(0.259f, 0.522f, 0.967f), 1.5f, false, true } // bottom, blue
+    };
+}
+
+LightManager::~LightManager()
+{
+}
+
+void LightManager::SetPointLights(unsigned int count, float extent, unsigned int seed)
+{
+    m_Lights.resize(m_NumCameraLights);
+    if (count == 0)
+        return;
+
+    // expected number of spheres covering a point: count * (4/3 pi r^3) / (2 extent)^3
+    const float LIGHTS_PER_POINT = 8.0f;
+    float volume = 8.0f * extent * extent * extent;
+    float radius = std::cbrt(LIGHTS_PER_POINT * volume / (count * 4.18879f));
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> coordinate(-extent, extent);
+    std::uniform_real_distribution<float> hue(0.0f, 6.0f);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // fully saturated color from the hue
+        float h = hue(generator);
+        glm::vec3 color = glm::clamp(glm::vec3(std::abs(h - 3.0f) - 1.0f, 2.0f - std::abs(h - 2.0f), 2.0f - std::abs(h - 4.0f)), 0.0f, 1.0f);
+
+        glm::vec3 position(coordinate(generator), coordinate(generator), coordinate(generator));
+        m_Lights.push_back({ position, radius, color, 1.0f, true, false });
+    }
+}
+
+unsigned int LightManager::GetNumPointLights() const
+{
+    return static_cast<unsigned int>(m_Lights.size()) - m_NumCameraLights;
+}
+
+void LightManager::BuildClusterBounds()
+{
+    m_ClusterMin.resize(NUM_CLUSTERS);
+    m_ClusterMax.resize(NUM_CLUSTERS);
+
+    float tanY = std::tan(m_FovY / 2.0f);
+    float tanX = tanY * m_Aspect;
+    for (unsigned int slice = 0; slice < CLUSTER_SLICES; slice++)
+    {
+        // same exponential split as the shaders, so every slice covers the same ratio of depths
+        float nearDepth = m_Near * std::pow(m_Far / m_Near, static_cast<float>(slice) / CLUSTER_SLICES);
+        float farDepth = m_Near * std::pow(m_Far / m_Near, static_cast<float>(slice + 1) / CLUSTER_SLICES);
+        for (unsigned int y = 0; y < CLUSTER_TILES_Y; y++)
+        {
+            for (unsigned int x = 0; x < CLUSTER_TILES_X; x++)
+            {
+                // tile edges on the plane at depth 1, window y goes up like view y
+                float left = tanX * (2.0f * x / CLUSTER_TILES_X - 1.0f);
+                float right = tanX * (2.0f * (x + 1) / CLUSTER_TILES_X - 1.0f);
+                float bottom = tanY * (2.0f * y / CLUSTER_TILES_Y - 1.0f);
+                float top = tanY * (2.0f * (y + 1) / CLUSTER_TILES_Y - 1.0f);
+
+                unsigned int cluster = x + CLUSTER_TILES_X * (y + CLUSTER_TILES_Y * slice);
+                m_ClusterMin[cluster] = glm::vec3(std::min(left * nearDepth, left * farDepth), std::min(bottom * nearDepth, bottom * farDepth), -farDepth);
+                m_ClusterMax[cluster] = glm::vec3(std::max(right * nearDepth, right * farDepth), std::max(top * nearDepth, top * farDepth), -nearDepth);
+            }
+        }
+    }
+}
+
+void LightManager::Build(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane)
+{
+    if (fovY != m_FovY || aspect != m_Aspect || nearPlane != m_Near || farPlane != m_Far)
+    {
+        m_FovY = fovY; m_Aspect = aspect; m_Near = nearPlane; m_Far = farPlane;
+        BuildClusterBounds();
+    }
+
+    // enabled lights in view space, lights reaching everything come first and are in no cluster,
+    // the shaders loop over them directly
+    m_GPULights.clear();
+    for (unsigned int pass = 0; pass < 2; pass++)
+    {
+        for (const PointLight& light : m_Lights)
+        {
+            if (!light.enabled || (light.radius <= 0.0f) != (pass == 0))
+                continue;
+
+            glm::vec3 position = light.attached ? light.position : glm::vec3(view * glm::vec4(light.position, 1.0f));
+            m_GPULights.push_back({ glm::vec4(position, light.radius), glm::vec4(light.color, light.brightness) });
+        }
+        if (pass == 0)
+            m_NumGlobalLights = static_cast<unsigned int>(m_GPULights.size());
+    }
+
+    // without clustering the shaders loop over every light themselves and read no cluster
+    if (!m_Clustered)
+    {
+        m_ClusterRanges.clear();
+        m_LightIndices.clear();
+        return;
+    }
+
+    // lights whose depth range meets each slice, so the clusters only test those
+    std::vector<std::vector<unsigned int>> sliceLights(CLUSTER_SLICES);
+    for (unsigned int i = m_NumGlobalLights; i < m_GPULights.size(); i++)
+    {
+        float radius = m_GPULights[i].positionRadius.w;
+
+        float depth = -m_GPULights[i].positionRadius.z;
+        for (unsigned int slice = 0; slice < CLUSTER_SLICES; slice++)
+        {
+            unsigned int cluster = CLUSTER_TILES_X * CLUSTER_TILES_Y * slice;
+            if (depth + radius >= -m_ClusterMax[cluster].z && depth - radius <= -m_ClusterMin[cluster].z)
+                sliceLights[slice].push_back(i);
+        }
+    }
+
+    // sphere against box of every cluster, each cluster only writes its own list
+    std::vector<std::vector<unsigned int>> clusterLights(NUM_CLUSTERS);
+    parallelFor(NUM_CLUSTERS, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int cluster = begin; cluster < end; cluster++)
+            {
+                std::vector<unsigned int>& lights = clusterLights[cluster];
+
+                unsigned int slice = cluster / (CLUSTER_TILES_X * CLUSTER_TILES_Y);
+                for (unsigned int i : sliceLights[slice])
+                {
+                    glm::vec3 center = glm::vec3(m_GPULights[i].positionRadius);
+                    float radius = m_GPULights[i].positionRadius.w;
+                    glm::vec3 closest = glm::clamp(center, m_ClusterMin[cluster], m_ClusterMax[cluster]);
+                    glm::vec3 offset = closest - center;
+                    if (glm::dot(offset, offset) <= radius * radius)
+                        lights.push_back(i);
+                }
+            }
+        });
+
+    // flatten into one index list
+    m_ClusterRanges.resize(NUM_CLUSTERS);
+    m_LightIndices.clear();
+    for (unsigned int cluster = 0; cluster < NUM_CLUSTERS; cluster++)
+    {
+        m_ClusterRanges[cluster] = glm::uvec2(static_cast<unsigned int>(m_LightIndices.size()), static_cast<unsigned int>(clusterLights[cluster].size()));
+        m_LightIndices.insert(m_LightIndices.end(), clusterLights[cluster].begin(), clusterLights[cluster].end());
+    }
+}
+
+void LightManager::Upload()
+{
+    // storage buffers cannot be empty, a zero entry stands in and is never read
+    GPULight noLight{};
+    glm::uvec2 noRange(0);
+    unsigned int noIndex = 0;
+    if (m_GPULights.empty())
+        m_LightBuffer.Assign(&noLight, sizeof(noLight), DRAW_MODE::DYNAMIC);
+    else
+        m_LightBuffer.Assign(m_GPULights.data(), static_cast<unsigned int>(m_GPULights.size() * sizeof(GPULight)), DRAW_MODE::DYNAMIC);
+    if (m_ClusterRanges.empty())
+        m_ClusterBuffer.Assign(&noRange, sizeof(noRange), DRAW_MODE::DYNAMIC);
+    else
+        m_ClusterBuffer.Assign(m_ClusterRanges.data(), static_cast<unsigned int>(m_ClusterRanges.size() * sizeof(glm::uvec2)), DRAW_MODE::DYNAMIC);
+    if (m_LightIndices.empty())
+        m_IndexBuffer.Assign(&noIndex, sizeof(noIndex), DRAW_MODE::DYNAMIC);
+    else
+        m_IndexBuffer.Assign(m_LightIndices.data(), static_cast<unsigned int>(m_LightIndices.size() * sizeof(unsigned int)), DRAW_MODE::DYNAMIC);
+
+    m_LightBuffer.BindBase(LIGHT_STORAGE_BINDING);
+    m_ClusterBuffer.BindBase(CLUSTER_STORAGE_BINDING);
+    m_IndexBuffer.BindBase(LIGHT_INDEX_STORAGE_BINDING);
+}
+
+ClusterBlock LightManager::GetBlock(unsigned int width, unsigned int height) const
+{
+    ClusterBlock block;
+    block.grid = glm::uvec4(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES, static_cast<unsigned int>(m_GPULights.size()));
+    block.params = glm::vec4(static_cast<float>(width), static_cast<float>(height), m_Near, m_Far);
+    block.counts = glm::uvec4(m_NumGlobalLights, m_Clustered ? 0 : 1, 0, 0);
+    return block;
+}
+
+unsigned int LightManager::GetNumActiveLights() const
+{
+    return static_cast<unsigned int>(m_GPULights.size());
+}
+
+unsigned int LightManager::GetNumGlobalLights() const
+{
+    return m_NumGlobalLights;
+}
+
+unsigned int LightManager::GetMaxClusterLights() const
+{
+    // unclustered, every fragment goes through every light with a radius
+    if (!m_Clustered)
+        return GetNumActiveLights() - m_NumGlobalLights;
+
+    unsigned int maxLights = 0;
+    for (glm::uvec2 range : m_ClusterRanges)
+    {
+        maxLights = std::max(maxLights, range.y);
+    }
+    return maxLights;
+}
+
+float LightManager::GetAverageClusterLights() const
+{
+    if (!m_Clustered)
+        return static_cast<float>(GetNumActiveLights() - m_NumGlobalLights);
+    return m_ClusterRanges.empty() ? 0.0f : static_cast<float>(m_LightIndices.size()) / m_ClusterRanges.size();
+}
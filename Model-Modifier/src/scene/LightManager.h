@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "../external/glm/glm.hpp"
+
+#include "../renderer/GrowableBuffer.h"
+#include "../renderer/UniformBuffer.h"
+
+// point light, a radius of 0 reaches everything
+struct PointLight
+{
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+	float brightness;
+	bool enabled;
+	bool attached; // follows the camera, the position is in view space instead of world space
+};
+
+// std430 light as read by the shaders, in view space
+struct GPULight
+{
+	glm::vec4 positionRadius;
+	glm::vec4 colorBrightness;
+};
+
+// froxel grid over the view frustum: screen tiles along x and y, exponential slices along the depth
+const unsigned int CLUSTER_TILES_X = 16;
+const unsigned int CLUSTER_TILES_Y = 9;
+const unsigned int CLUSTER_SLICES = 24;
+const unsigned int NUM_CLUSTERS = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+
+// any number of lights, assigned every frame to the clusters their sphere touches
+// so each fragment only shades the lights of its own cluster
+class LightManager
+{
+public:
+	LightManager();
+	~LightManager();
+
+	// replace the point lights (not the camera lights) by count random ones inside a cube of half size extent,
+	// radii shrink as the count grows so about the same number of lights reaches any point
+	void SetPointLights(unsigned int count, float extent = 1.5f, unsigned int seed = 1);
+	unsigned int GetNumPointLights() const;
+
+	// assign the enabled lights to the clusters of the view, on the CPU in parallel
+	void Build(const glm::mat4& view, float fovY, float aspect, float nearPlane, float farPlane);
+	// send the lights and their cluster lists to the shader storage buffers
+	void Upload();
+	// contents of the Lights uniform block
+	ClusterBlock GetBlock(unsigned int width, unsigned int height) const;
+
+	unsigned int GetNumActiveLights() const;
+	// enabled lights with no radius, the first ones in m_GPULights
+	unsigned int GetNumGlobalLights() const;
+	unsigned int GetMaxClusterLights() const;
+	float GetAverageClusterLights() const;
+
+private:
+	void BuildClusterBounds();
+
+public:
+	std::vector<PointLight> m_Lights;
+	unsigned int m_NumCameraLights; // the first lights, edited in the UI
+	// without clustering the shaders go through every point light, for comparison
+	bool m_Clustered;
+
+	std::vector<GPULight> m_GPULights;
+	unsigned int m_NumGlobalLights;
+	std::vector<glm::uvec2> m_ClusterRanges; // first index in m_LightIndices and number of lights, per cluster
+	std::vector<unsigned int> m_LightIndices;
+
+private:
+	// view space bounding boxes of the clusters, rebuilt when the projection changes
+	std::vector<glm::vec3> m_ClusterMin;
+	std::vector<glm::vec3> m_ClusterMax;
+	float m_FovY, m_Aspect, m_Near, m_Far;
+
+	GrowableBuffer m_LightBuffer;
+	GrowableBuffer m_ClusterBuffer;
+	GrowableBuffer m_IndexBuffer;
+};
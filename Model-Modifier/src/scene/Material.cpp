@@ -11,3 +11,13 @@ Material::Material()
 Material::~Material()
 {
 }
+
+MaterialBlock Material::GetBlock() const
+{
+	MaterialBlock block{};
+	block.ambient = glm::vec3(m_Ambient[0], m_Ambient[1], m_Ambient[2]);
+	block.diffuse = glm::vec3(m_Diffuse[0], m_Diffuse[1], m_Diffuse[2]);
+	block.specular = glm::vec3(m_Specular[0], m_Specular[1], m_Specular[2]);
+	block.shine = m_Shine;
+	return block;
+}
@@ -5,12 +5,17 @@
 #include "../external/glm/ext/vector_float3.hpp"
 #include "../external/glm/geometric.hpp"
 
+#include "../renderer/UniformBuffer.h"
+
 class Material
 {
 public:
 	Material();
 	~Material();
 
+	// std140 contents of the Material uniform block, the shader specific constants are left at zero
+	MaterialBlock GetBlock() const;
+
 public:
 	std::vector<float> m_Ambient;
 	std::vector<float> m_Diffuse;
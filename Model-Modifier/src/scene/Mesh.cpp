@@ -1,10 +1,71 @@
 #include "Mesh.h"
 
-Mesh::Mesh(Object obj, int shading)
-    : m_Object(obj), m_ShadingType(shading)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// directions of the view dependent triangle orders, the diagonals are not normalized
+static const glm::vec3 VIEW_DIRECTIONS[NUM_VIEW_ORDERS] = {
+    { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+    { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 }, { -1, 1, 1 }, { -1, 1, -1 }, { -1, -1, 1 }, { -1, -1, -1 }
+};
+
+// runs of the cache optimized order are compact patches, the view orders sort whole runs
+static const unsigned int VIEW_ORDER_CLUSTER_SIZE = 128; // triangles
+
+// zero instead of NaN for faces without area and vertices without faces
+static glm::vec3 SafeNormalize(glm::vec3 vector)
+{
+    float length = glm::length(vector);
+    return length > 0.0f ? vector / length : glm::vec3(0.0f);
+}
+
+// a topology edit removes a face by repeating one of its corners
+static bool IsRemovedFace(const std::vector<unsigned int>& corners)
+{
+    return corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0];
+}
+
+static bool IsFaceOf(const Object& obj, unsigned int vertIdx, unsigned int faceIdx)
+{
+    const std::vector<unsigned int>& corners = obj.m_TriFaceIndices[faceIdx];
+    return !IsRemovedFace(corners) && (corners[0] == vertIdx || corners[1] == vertIdx || corners[2] == vertIdx);
+}
+
+static glm::vec3 FaceNormal(const Object& obj, unsigned int faceIdx)
+{
+    const std::vector<unsigned int>& corners = obj.m_TriFaceIndices[faceIdx];
+    return SafeNormalize(glm::cross(
+        obj.m_VertexPos[corners[1]] - obj.m_VertexPos[corners[0]],
+        obj.m_VertexPos[corners[2]] - obj.m_VertexPos[corners[0]]
+    ));
+}
+
+// sorted items as ranges (first * itemSize, count * itemSize), items less than maxGap apart share a range
+// so the number of uploads stays small
+static void AppendRanges(std::vector<unsigned int>& items, unsigned int maxGap, unsigned int itemSize, std::vector<std::pair<unsigned int, unsigned int>>& ranges)
+{
+    std::sort(items.begin(), items.end());
+    for (unsigned int i = 0; i < items.size();)
+    {
+        unsigned int first = items[i];
+        unsigned int last = first;
+        for (i++; i < items.size() && items[i] <= last + maxGap; i++)
+        {
+            last = items[i];
+        }
+        ranges.push_back({ itemSize * first, itemSize * (last - first + 1) });
+    }
+}
+
+Mesh::Mesh(Object obj, int shading, int format, bool reorderVertices)
+    : m_Object(obj), m_ShadingType(shading), m_Version(0), m_VertexFormat(format), m_PackedFormat(format), m_ReorderVertices(reorderVertices), m_ViewOrders(false),
+      m_OutNumVert(0), m_OutVertices(nullptr), m_OutVertexBytes(0), m_OutVertexData(nullptr), m_OutNumIdx(0), m_OutNumOrders(1), m_OutIndices(nullptr),
+      m_ACMRBefore(0.0f), m_ACMRAfter(0.0f), m_DirtyFromVersion(0), m_DirtyShading(BufferShading(shading)), m_MaxPositionError(0.0f), m_MaxNormalError(0.0f)
 {
     BuildFaceNormals();
-    BuildVerticesIndices();
+    BuildVertexAdjacency();
+    Rebuild(shading);
 }
 
 Mesh::~Mesh()
@@ -16,208 +77,759 @@ void Mesh::BuildFaceNormals()
 {
     // build face normal vectors from obj
     m_FaceNormals.resize(m_Object.m_TriFaceIndices.size());
-    for (unsigned int i = 0; i < m_Object.m_TriFaceIndices.size(); i++)
+    parallelFor(static_cast<unsigned int>(m_Object.m_TriFaceIndices.size()), [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                m_FaceNormals[i] = FaceNormal(m_Object, i);
+            }
+        });
+}
+
+void Mesh::BuildVertexAdjacency()
+{
+    // get vertex-face connectivity: get all faces that touch the a given vertex
+    unsigned int numFaces = static_cast<unsigned int>(m_Object.m_TriFaceIndices.size());
+    unsigned int numVertices = static_cast<unsigned int>(m_Object.m_VertexPos.size());
+
+    // reserved pairs the object does not use yet, the others are counted with the faces
+    auto isUnused = [&](glm::uvec2 pair)
+    {
+        return pair.x < numVertices && pair.y < numFaces && !IsFaceOf(m_Object, pair.x, pair.y);
+    };
+
+    // count the faces of each vertex, removed faces touch nothing, then the unused reserved pairs,
+    // then prefix sum into offsets
+    m_VertFaceCounts.assign(numVertices, 0);
+    m_VertFaceOffsets.assign(numVertices + 1, 0);
+    for (unsigned int faceIdx = 0; faceIdx < numFaces; faceIdx++)
+    {
+        if (IsRemovedFace(m_Object.m_TriFaceIndices[faceIdx]))
+            continue;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            m_VertFaceCounts[m_Object.m_TriFaceIndices[faceIdx][i]]++;
+        }
+    }
+    for (glm::uvec2 pair : m_ReservedAdjacency)
+    {
+        if (isUnused(pair))
+            m_VertFaceOffsets[pair.x + 1]++;
+    }
+    for (unsigned int i = 0; i < numVertices; i++)
     {
-        unsigned int ia = m_Object.m_TriFaceIndices[i][0];
-        unsigned int ib = m_Object.m_TriFaceIndices[i][1];
-        unsigned int ic = m_Object.m_TriFaceIndices[i][2];
-        glm::vec3 normal = glm::normalize(
-            glm::cross(
-                m_Object.m_VertexPos[ib] - m_Object.m_VertexPos[ia],
-                m_Object.m_VertexPos[ic] - m_Object.m_VertexPos[ia]
-            )
-        );
-        m_FaceNormals[i] = normal;
+        m_VertFaceOffsets[i + 1] += m_VertFaceOffsets[i] + m_VertFaceCounts[i];
     }
+
+    // faces are added in increasing order, so every vertex sums its normals in the same order as before
+    m_VertFaces.resize(m_VertFaceOffsets[numVertices]);
+    std::vector<unsigned int> fill(m_VertFaceOffsets.begin(), m_VertFaceOffsets.end() - 1);
+    for (unsigned int faceIdx = 0; faceIdx < numFaces; faceIdx++)
+    {
+        if (IsRemovedFace(m_Object.m_TriFaceIndices[faceIdx]))
+            continue;
+        for (unsigned int i = 0; i < 3; i++)
+        {
+            m_VertFaces[fill[m_Object.m_TriFaceIndices[faceIdx][i]]++] = faceIdx;
+        }
+    }
+    for (glm::uvec2 pair : m_ReservedAdjacency)
+    {
+        if (isUnused(pair))
+            m_VertFaces[fill[pair.x]++] = pair.y;
+    }
+}
+
+void Mesh::ReserveAdjacency(std::vector<glm::uvec2> pairs)
+{
+    std::sort(pairs.begin(), pairs.end(), [](glm::uvec2 a, glm::uvec2 b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    m_ReservedAdjacency.swap(pairs);
+    BuildVertexAdjacency();
 }
 
 void Mesh::BuildVerticesIndices()
 {
     unsigned int numFaces = static_cast<unsigned int>(m_Object.m_TriFaceIndices.size());
+    unsigned int numVertices = static_cast<unsigned int>(m_Object.m_VertexPos.size());
 
     // build output items to OpenGL
-    if (m_ShadingType == FLAT) // flat shading
+    if (m_ShadingType == FLAT || m_ShadingType == SMOOTH) // flat and smooth shading
     {
+        // flat shading shares the indexed layout, the shaders derive face normals from screen space derivatives
+        // and only fall back to these vertex normals for points and lines
+
         // build out the VBO with x,y,z coords of vertices, and normal vectors
-        m_OutNumVert = 2 * 3 * 3 * numFaces;
+        m_OutNumVert = 2 * 3 * numVertices;
         m_OutVertices = new float[m_OutNumVert] {};
-        for (unsigned int i = 0; i < numFaces; i++)
-        {
-            for (unsigned int j = 0; j < 3; j++)
+
+        // build smooth vertex normals by average neighbouring faces normals, each vertex only writes its own entries
+        parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
             {
-                // ith face, jth corner, xyz coordinates and normals
-                m_OutVertices[18 * i + 6 * j + 0] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].x;
-                m_OutVertices[18 * i + 6 * j + 1] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].y;
-                m_OutVertices[18 * i + 6 * j + 2] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].z;
-
-                m_OutVertices[18 * i + 6 * j + 3] = m_FaceNormals[i].x;
-                m_OutVertices[18 * i + 6 * j + 4] = m_FaceNormals[i].y;
-                m_OutVertices[18 * i + 6 * j + 5] = m_FaceNormals[i].z;
-            }
-        }
+                for (unsigned int i = begin; i < end; i++)
+                {
+                    glm::vec3 currVertNormal = glm::vec3(0, 0, 0);
+
+                    // summ through each neighbouring face
+                    for (unsigned int k = m_VertFaceOffsets[i]; k < m_VertFaceOffsets[i] + m_VertFaceCounts[i]; k++)
+                    {
+                        currVertNormal += m_FaceNormals[m_VertFaces[k]];
+                    }
+                    currVertNormal = SafeNormalize(currVertNormal);
+
+                    // xyz of the vertex
+                    m_OutVertices[6 * i + 0] = m_Object.m_VertexPos[i].x;
+                    m_OutVertices[6 * i + 1] = m_Object.m_VertexPos[i].y;
+                    m_OutVertices[6 * i + 2] = m_Object.m_VertexPos[i].z;
+
+                    // xyz of the normal
+                    m_OutVertices[6 * i + 3] = currVertNormal.x;
+                    m_OutVertices[6 * i + 4] = currVertNormal.y;
+                    m_OutVertices[6 * i + 5] = currVertNormal.z;
+                }
+            });
 
         // build out IBO indices
-        m_OutNumIdx = 3 * 3 * numFaces;
+        m_OutNumIdx = 3 * numFaces;
         m_OutIndices = new unsigned int[m_OutNumIdx];
-        for (unsigned int i = 0; i < m_OutNumIdx; i++)
+        for (unsigned int i = 0; i < numFaces; i++)
         {
-            m_OutIndices[i] = i;
+            m_OutIndices[3 * i + 0] = m_Object.m_TriFaceIndices[i][0];
+            m_OutIndices[3 * i + 1] = m_Object.m_TriFaceIndices[i][1];
+            m_OutIndices[3 * i + 2] = m_Object.m_TriFaceIndices[i][2];
         }
     }
     else if (m_ShadingType == MIXED) // mixed shading
     {
-        // get vertex-face connectivity: get all faces that touch the a given vertex
-        std::unordered_map<unsigned int, std::vector<unsigned int>> vertAdjFaces(m_Object.m_VertexPos.size());
-        for (unsigned int faceIdx = 0; faceIdx < numFaces; faceIdx++)
+        // contiguous copy of the corners, the searches below touch every face around a vertex
+        std::vector<unsigned int> faceCorners(3 * numFaces);
+        for (unsigned int i = 0; i < numFaces; i++)
         {
-            std::vector<unsigned int> faceVertIdx = m_Object.m_TriFaceIndices[faceIdx];
-            // add face index to the connecting vertices
-            for (unsigned int i = 0; i < 3; i++)
-            {
-                vertAdjFaces[faceVertIdx[i]].push_back(faceIdx);
-            }
+            faceCorners[3 * i + 0] = m_Object.m_TriFaceIndices[i][0];
+            faceCorners[3 * i + 1] = m_Object.m_TriFaceIndices[i][1];
+            faceCorners[3 * i + 2] = m_Object.m_TriFaceIndices[i][2];
         }
 
-        // build mixed vertex normals by first getting current face normal, then average adjacent normals
-        std::vector<std::vector<glm::vec3>> cornerVertexNormals(numFaces);
-        for (unsigned int currFace = 0; currFace < numFaces; currFace++)
+        // group the faces around each vertex into smoothing fans: every edge leaving the vertex is tested once against
+        // the dihedral threshold, faces across a smooth edge share the fan, creases, boundaries and non-manifold edges split it
+        // fanOf follows the CSR adjacency and gives the local fan of each face of the vertex
+        std::vector<unsigned int> fanOf(m_VertFaces.size());
+        std::vector<unsigned int> fanOffsets(numVertices + 1, 0);
+        parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
+            {
+                std::vector<unsigned int> nextCorner;
+                std::vector<unsigned int> parent;
+                for (unsigned int i = begin; i < end; i++)
+                {
+                    unsigned int first = m_VertFaceOffsets[i];
+                    unsigned int numAdj = m_VertFaceCounts[i];
+
+                    // the vertex following this one in each face, the edge from here to it is the one owned by the face
+                    nextCorner.resize(numAdj);
+                    parent.resize(numAdj);
+                    for (unsigned int k = 0; k < numAdj; k++)
+                    {
+                        const unsigned int* corners = &faceCorners[3 * m_VertFaces[first + k]];
+                        unsigned int corner = corners[0] == i ? 0 : (corners[1] == i ? 1 : 2);
+                        nextCorner[k] = corners[(corner + 1) % 3];
+                        parent[k] = k;
+                    }
+                    auto findRoot = [&](unsigned int k)
+                    {
+                        while (parent[k] != k)
+                        {
+                            parent[k] = parent[parent[k]];
+                            k = parent[k];
+                        }
+                        return k;
+                    };
+
+                    for (unsigned int k = 0; k < numAdj; k++)
+                    {
+                        // the other faces of the vertex containing the edge
+                        unsigned int adjLocal = 0;
+                        unsigned int numAdjFaces = 0;
+                        for (unsigned int l = 0; l < numAdj; l++)
+                        {
+                            if (l == k || m_VertFaces[first + l] == m_VertFaces[first + k])
+                                continue;
+
+                            const unsigned int* corners = &faceCorners[3 * m_VertFaces[first + l]];
+                            if (corners[0] == nextCorner[k] || corners[1] == nextCorner[k] || corners[2] == nextCorner[k])
+                            {
+                                adjLocal = l;
+                                numAdjFaces++;
+                            }
+                        }
+
+                        // threshold set to 0.9f here
+                        if (numAdjFaces == 1 &&
+                            glm::dot(m_FaceNormals[m_VertFaces[first + k]], m_FaceNormals[m_VertFaces[first + adjLocal]]) > 0.9f)
+                        {
+                            parent[findRoot(k)] = findRoot(adjLocal);
+                        }
+                    }
+
+                    // number the fans by their root, then hand the number to every face of the fan
+                    unsigned int numFans = 0;
+                    for (unsigned int k = 0; k < numAdj; k++)
+                    {
+                        if (findRoot(k) == k)
+                            fanOf[first + k] = numFans++;
+                    }
+                    for (unsigned int k = 0; k < numAdj; k++)
+                    {
+                        fanOf[first + k] = fanOf[first + findRoot(k)];
+                    }
+                    fanOffsets[i + 1] = numFans;
+                }
+            });
+        for (unsigned int i = 0; i < numVertices; i++)
         {
-            // get face normal
-            glm::vec3 currFaceNormal = m_FaceNormals[currFace];
-            std::vector<glm::vec3> faceCornerNormals;
+            fanOffsets[i + 1] += fanOffsets[i];
+        }
 
-            for (unsigned int currCorner = 0; currCorner < m_Object.m_TriFaceIndices[currFace].size(); currCorner++)
-            {
-                // corner normal to be stored
-                glm::vec3 currCornerNormal {0};
+        // build out the VBO with x,y,z coords of vertices, and normal vectors, one vertex per fan
+        m_OutNumVert = 2 * 3 * fanOffsets[numVertices];
+        m_OutVertices = new float[m_OutNumVert] {};
+        // removed faces are in no fan, their corners all stay on vertex 0
+        m_OutNumIdx = 3 * numFaces;
+        m_OutIndices = new unsigned int[m_OutNumIdx] {};
 
-                // go through all neighbour faces (including current face)
-                for (unsigned int adjFace : vertAdjFaces[m_Object.m_TriFaceIndices[currFace][currCorner]])
+        // fan normals average the face normals of the fan, each vertex only writes its own fans and corners
+        parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
+            {
+                std::vector<glm::vec3> fanNormals;
+                for (unsigned int i = begin; i < end; i++)
                 {
-                    glm::vec3 adjFaceNormal = m_FaceNormals[adjFace];
-                    // if adjacent face is "close" to current face, then add the adj face normal to current corner normal
-                    if (glm::dot(currFaceNormal, adjFaceNormal) > 0.9f) // threshold set to 0.9f here
+                    unsigned int numFans = fanOffsets[i + 1] - fanOffsets[i];
+                    fanNormals.assign(numFans, glm::vec3{ 0 });
+                    for (unsigned int k = m_VertFaceOffsets[i]; k < m_VertFaceOffsets[i] + m_VertFaceCounts[i]; k++)
+                    {
+                        unsigned int faceIdx = m_VertFaces[k];
+                        fanNormals[fanOf[k]] += m_FaceNormals[faceIdx];
+
+                        // point the corners of the face at this vertex to its fan
+                        for (unsigned int corner = 0; corner < 3; corner++)
+                        {
+                            if (faceCorners[3 * faceIdx + corner] == i)
+                                m_OutIndices[3 * faceIdx + corner] = fanOffsets[i] + fanOf[k];
+                        }
+                    }
+
+                    for (unsigned int fan = 0; fan < numFans; fan++)
                     {
-                        currCornerNormal += adjFaceNormal;
+                        glm::vec3 fanNormal = SafeNormalize(fanNormals[fan]);
+
+                        float* vertex = m_OutVertices + 6 * (fanOffsets[i] + fan);
+                        vertex[0] = m_Object.m_VertexPos[i].x;
+                        vertex[1] = m_Object.m_VertexPos[i].y;
+                        vertex[2] = m_Object.m_VertexPos[i].z;
+
+                        vertex[3] = fanNormal.x;
+                        vertex[4] = fanNormal.y;
+                        vertex[5] = fanNormal.z;
                     }
                 }
-                faceCornerNormals.push_back(glm::normalize(currCornerNormal));
-            }
-            cornerVertexNormals[currFace] = faceCornerNormals;
+            });
+    }
+
+    OptimizeVerticesIndices();
+}
+
+void Mesh::OptimizeVerticesIndices()
+{
+    unsigned int numVertices = m_OutNumVert / 6;
+    m_ACMRBefore = ComputeACMR(m_OutIndices, m_OutNumIdx, numVertices);
+
+    // triangles first, so the vertices are then numbered in the order the cache wants them
+    // faces were emitted in order, the triangle each one ends up at is kept for edits
+    std::vector<unsigned int> order = OptimizeVertexCache(m_OutIndices, m_OutNumIdx, numVertices);
+    m_OutFaceTriangles.resize(order.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        m_OutFaceTriangles[order[i]] = i;
+    }
+    m_OutVertexRemap.clear();
+    if (m_ReorderVertices)
+    {
+        std::vector<unsigned int> remap = OptimizeVertexFetch(m_OutIndices, m_OutNumIdx, numVertices);
+
+        float* reordered = new float[m_OutNumVert];
+        for (unsigned int i = 0; i < numVertices; i++)
+        {
+            std::memcpy(reordered + 6 * remap[i], m_OutVertices + 6 * i, 6 * sizeof(float));
         }
+        delete[] m_OutVertices;
+        m_OutVertices = reordered;
+        m_OutVertexRemap.swap(remap);
+    }
 
-        // build out the VBO with x,y,z coords of vertices, and normal vectors
-        m_OutNumVert = 2 * 3 * 3 * numFaces;
-        m_OutVertices = new float[m_OutNumVert] {};
-        for (unsigned int i = 0; i < numFaces; i++)
+    m_ACMRAfter = ComputeACMR(m_OutIndices, m_OutNumIdx, numVertices);
+
+    m_OutNumOrders = 1;
+    m_OutViewClusterStarts.clear();
+    if (m_ViewOrders)
+        BuildViewOrders();
+}
+
+void Mesh::BuildViewOrders()
+{
+    // sorting whole runs of the cache optimized order keeps most of the cache hits
+    const unsigned int CLUSTER_SIZE = VIEW_ORDER_CLUSTER_SIZE;
+
+    unsigned int numTriangles = m_OutNumIdx / 3;
+    unsigned int numClusters = (numTriangles + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+
+    // centroid of the corners of each cluster
+    std::vector<glm::vec3> centroids(numClusters, glm::vec3{ 0 });
+    for (unsigned int i = 0; i < m_OutNumIdx; i++)
+    {
+        const float* position = m_OutVertices + 6 * m_OutIndices[i];
+        centroids[i / (3 * CLUSTER_SIZE)] += glm::vec3(position[0], position[1], position[2]);
+    }
+
+    unsigned int* orders = new unsigned int[(1 + NUM_VIEW_ORDERS) * m_OutNumIdx];
+    std::copy(m_OutIndices, m_OutIndices + m_OutNumIdx, orders);
+    m_OutViewClusterStarts.assign(NUM_VIEW_ORDERS * numClusters, 0);
+    parallelFor(NUM_VIEW_ORDERS, [&](unsigned int begin, unsigned int end)
         {
-            for (unsigned int j = 0; j < 3; j++)
+            std::vector<unsigned int> clusterOrder(numClusters);
+            std::vector<float> depths(numClusters);
+            for (unsigned int view = begin; view < end; view++)
             {
-                // ith face, jth corner, xyz coordinates and normals
-                m_OutVertices[18 * i + 6 * j + 0] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].x;
-                m_OutVertices[18 * i + 6 * j + 1] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].y;
-                m_OutVertices[18 * i + 6 * j + 2] = m_Object.m_VertexPos[m_Object.m_TriFaceIndices[i][j]].z;
-
-                m_OutVertices[18 * i + 6 * j + 3] = cornerVertexNormals[i][j].x;
-                m_OutVertices[18 * i + 6 * j + 4] = cornerVertexNormals[i][j].y;
-                m_OutVertices[18 * i + 6 * j + 5] = cornerVertexNormals[i][j].z;
+                // front to back, the camera looks along the view direction
+                for (unsigned int c = 0; c < numClusters; c++)
+                {
+                    clusterOrder[c] = c;
+                    depths[c] = glm::dot(centroids[c], VIEW_DIRECTIONS[view]);
+                }
+                std::sort(clusterOrder.begin(), clusterOrder.end(), [&](unsigned int a, unsigned int b) { return depths[a] < depths[b]; });
+
+                unsigned int* order = orders + (1 + view) * m_OutNumIdx;
+                for (unsigned int cluster : clusterOrder)
+                {
+                    m_OutViewClusterStarts[view * numClusters + cluster] = static_cast<unsigned int>(order - (orders + (1 + view) * m_OutNumIdx)) / 3;
+                    unsigned int first = 3 * CLUSTER_SIZE * cluster;
+                    unsigned int last = std::min(first + 3 * CLUSTER_SIZE, m_OutNumIdx);
+                    order = std::copy(m_OutIndices + first, m_OutIndices + last, order);
+                }
             }
-        }
+        });
 
-        // build out IBO indices
-        m_OutNumIdx = 3 * 3 * numFaces;
-        m_OutIndices = new unsigned int[m_OutNumIdx];
-        for (unsigned int i = 0; i < m_OutNumIdx; i++)
+    delete[] m_OutIndices;
+    m_OutIndices = orders;
+    m_OutNumOrders = 1 + NUM_VIEW_ORDERS;
+}
+
+float* Mesh::PackVertices()
+{
+    // float vertices are uploaded as they are
+    m_PackedFormat = m_VertexFormat;
+    if (m_VertexFormat == FLOAT_VERTEX)
+    {
+        m_OutVertexBytes = m_OutNumVert * sizeof(float);
+        m_OutVertexData = m_OutVertices;
+        m_MaxPositionError = 0.0f; m_MaxNormalError = 0.0f;
+        return m_OutVertices;
+    }
+
+    // 8 bytes of position then 4 bytes of normal per vertex
+    unsigned int numVertices = m_OutNumVert / 6;
+
+    // snorm16 would clamp positions moved out of the rescaled bounds by edits or simplification
+    if (m_VertexFormat == SNORM16_VERTEX && !InSnormRange(m_OutVertices, numVertices))
+        m_PackedFormat = HALF_VERTEX;
+    unsigned int vertexSize = GetVertexSize(m_VertexFormat);
+    float* packed = new float[vertexSize / sizeof(float) * numVertices];
+    unsigned char* packedBytes = reinterpret_cast<unsigned char*>(packed);
+
+    std::vector<float> positionErrors(numVertices);
+    std::vector<float> normalErrors(numVertices);
+    parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
         {
-            m_OutIndices[i] = i;
+            for (unsigned int i = begin; i < end; i++)
+            {
+                const float* vertex = m_OutVertices + 6 * i;
+                PackVertex(vertex, packedBytes + vertexSize * i);
+
+                glm::uint64 packedPosition;
+                glm::uint32 packedNormal;
+                std::memcpy(&packedPosition, packedBytes + vertexSize * i, sizeof(packedPosition));
+                std::memcpy(&packedNormal, packedBytes + vertexSize * i + sizeof(packedPosition), sizeof(packedNormal));
+                glm::vec4 decodedPosition = m_PackedFormat == SNORM16_VERTEX ? glm::unpackSnorm4x16(packedPosition) : glm::unpackHalf4x16(packedPosition);
+                glm::vec3 decodedNormal = glm::vec3(glm::unpackSnorm3x10_1x2(packedNormal));
+
+                positionErrors[i] = glm::length(glm::vec3(decodedPosition) - glm::vec3(vertex[0], vertex[1], vertex[2]));
+                normalErrors[i] = glm::length(glm::normalize(decodedNormal) - glm::vec3(vertex[3], vertex[4], vertex[5]));
+            }
+        });
+
+    // the float vertices are not kept
+    delete[] m_OutVertices;
+    m_OutNumVert = 0;
+    m_OutVertices = nullptr;
+    m_OutVertexBytes = vertexSize * numVertices;
+    m_OutVertexData = packed;
+
+    m_MaxPositionError = 0.0f; m_MaxNormalError = 0.0f;
+    for (unsigned int i = 0; i < numVertices; i++)
+    {
+        m_MaxPositionError = std::max(m_MaxPositionError, positionErrors[i]);
+        m_MaxNormalError = std::max(m_MaxNormalError, normalErrors[i]);
+    }
+    return packed;
+}
+
+bool Mesh::InSnormRange(const float* vertices, unsigned int numVertices)
+{
+    for (unsigned int i = 0; i < numVertices; i++)
+    {
+        for (unsigned int coord = 0; coord < 3; coord++)
+        {
+            if (std::abs(vertices[6 * i + coord]) > 1.0f)
+                return false;
         }
     }
-    else if (m_ShadingType == SMOOTH) // smooth shading
+    return true;
+}
+
+void Mesh::PackVertex(const float* vertex, unsigned char* packed) const
+{
+    glm::vec4 position{ vertex[0], vertex[1], vertex[2], 1.0f };
+    glm::vec4 normal{ vertex[3], vertex[4], vertex[5], 0.0f };
+
+    glm::uint64 packedPosition = m_PackedFormat == SNORM16_VERTEX ? glm::packSnorm4x16(position) : glm::packHalf4x16(position);
+    glm::uint32 packedNormal = glm::packSnorm3x10_1x2(normal);
+
+    std::memcpy(packed, &packedPosition, sizeof(packedPosition));
+    std::memcpy(packed + sizeof(packedPosition), &packedNormal, sizeof(packedNormal));
+}
+
+void Mesh::Update(const std::vector<unsigned int>& dirtyVertices, const std::vector<unsigned int>& rewiredFaces)
+{
+    // mixed shading regroups its fans when normals change, which changes the vertex count, it goes through the full rebuild
+    if (m_ShadingType == MIXED)
+    {
+        Rebuild();
+        return;
+    }
+
+    // a vertex leaving the snorm16 range switches every buffer to half floats, they are all packed again
+    if (m_PackedFormat == SNORM16_VERTEX)
     {
-        // get vertex-face connectivity: get all faces that touch the a given vertex
-        std::unordered_map<unsigned int, std::vector<unsigned int>> vertAdjFaces(m_Object.m_VertexPos.size());
-        for (unsigned int faceIdx = 0; faceIdx < numFaces; faceIdx++)
+        for (unsigned int vertIdx : dirtyVertices)
         {
-            std::vector<unsigned int> faceVertIdx = m_Object.m_TriFaceIndices[faceIdx];
-            // add face index to the connecting vertices
-            for (unsigned int i = 0; i < 3; i++)
+            glm::vec3 vertPos = m_Object.m_VertexPos[vertIdx];
+            if (std::max({ std::abs(vertPos.x), std::abs(vertPos.y), std::abs(vertPos.z) }) > 1.0f)
             {
-                vertAdjFaces[faceVertIdx[i]].push_back(faceIdx);
+                Rebuild();
+                return;
             }
         }
+    }
 
-        // build smooth vertex normals by average neighbouring faces normals
-        unsigned int numVertices = static_cast<unsigned int>(m_Object.m_VertexPos.size());
-        std::vector<glm::vec3> smoothVertexNormals(numVertices);
-        for (unsigned int i = 0; i < numVertices; i++)
+    // the other shading types are stale, they are built again when used
+    for (unsigned int i = 0; i < NUM_SHADING_TYPES; i++)
+    {
+        Evict(i);
+    }
+
+    // vertices whose faces changed: the moved ones, the ones that lost a face and the corners of the rewired faces
+    std::vector<unsigned int> touchedVertices(dirtyVertices);
+    for (unsigned int faceIdx : rewiredFaces)
+    {
+        const std::vector<unsigned int>& corners = m_Object.m_TriFaceIndices[faceIdx];
+        touchedVertices.insert(touchedVertices.end(), corners.begin(), corners.end());
+    }
+    std::sort(touchedVertices.begin(), touchedVertices.end());
+    touchedVertices.erase(std::unique(touchedVertices.begin(), touchedVertices.end()), touchedVertices.end());
+
+    // faces in use move to the front of the range of each vertex, the others stay reserved behind them
+    if (!rewiredFaces.empty())
+    {
+        for (unsigned int vertIdx : touchedVertices)
         {
-            glm::vec3 currPos = m_Object.m_VertexPos[i];
-            glm::vec3 currVertNormal = glm::vec3(0, 0, 0);
+            std::vector<unsigned int>::iterator first = m_VertFaces.begin() + m_VertFaceOffsets[vertIdx];
+            std::vector<unsigned int>::iterator last = m_VertFaces.begin() + m_VertFaceOffsets[vertIdx + 1];
+            std::vector<unsigned int>::iterator unused = std::stable_partition(first, last, [&](unsigned int faceIdx) { return IsFaceOf(m_Object, vertIdx, faceIdx); });
+            m_VertFaceCounts[vertIdx] = static_cast<unsigned int>(unused - first);
+        }
+    }
 
-            // summ through each neighbouring face
-            for (unsigned int adjFace : vertAdjFaces[i])
-            {
-                currVertNormal += m_FaceNormals[adjFace];
-            }
+    // faces around the touched vertices
+    std::vector<unsigned int> dirtyFaces(rewiredFaces);
+    for (unsigned int vertIdx : touchedVertices)
+    {
+        dirtyFaces.insert(dirtyFaces.end(), m_VertFaces.begin() + m_VertFaceOffsets[vertIdx], m_VertFaces.begin() + m_VertFaceOffsets[vertIdx] + m_VertFaceCounts[vertIdx]);
+    }
+    std::sort(dirtyFaces.begin(), dirtyFaces.end());
+    dirtyFaces.erase(std::unique(dirtyFaces.begin(), dirtyFaces.end()), dirtyFaces.end());
+
+    std::vector<unsigned int> ringVertices(touchedVertices);
+    for (unsigned int faceIdx : dirtyFaces)
+    {
+        const std::vector<unsigned int>& corners = m_Object.m_TriFaceIndices[faceIdx];
+        m_FaceNormals[faceIdx] = FaceNormal(m_Object, faceIdx);
+        ringVertices.insert(ringVertices.end(), corners.begin(), corners.end());
+    }
+    std::sort(ringVertices.begin(), ringVertices.end());
+    ringVertices.erase(std::unique(ringVertices.begin(), ringVertices.end()), ringVertices.end());
 
-            smoothVertexNormals[i] = glm::normalize(currVertNormal);
+    // vertex normals of the one-rings, written in place in the cached buffer
+    MeshBuffers& cached = m_Cached[BufferShading(m_ShadingType)];
+    unsigned int vertexSize = GetVertexSize(m_VertexFormat);
+    unsigned char* vertexBytes = reinterpret_cast<unsigned char*>(cached.vertexData);
+    std::vector<unsigned int> outVertices;
+    for (unsigned int vertIdx : ringVertices)
+    {
+        glm::vec3 vertNormal = glm::vec3(0, 0, 0);
+        for (unsigned int k = m_VertFaceOffsets[vertIdx]; k < m_VertFaceOffsets[vertIdx] + m_VertFaceCounts[vertIdx]; k++)
+        {
+            vertNormal += m_FaceNormals[m_VertFaces[k]];
         }
+        vertNormal = SafeNormalize(vertNormal);
 
-        // build out the VBO with x,y,z coords of vertices, and normal vectors
-        m_OutNumVert = 2 * 3 * numVertices;
-        m_OutVertices = new float[m_OutNumVert] {};
-        for (unsigned int i = 0; i < numVertices; i++)
+        glm::vec3 vertPos = m_Object.m_VertexPos[vertIdx];
+        float vertex[6] = { vertPos.x, vertPos.y, vertPos.z, vertNormal.x, vertNormal.y, vertNormal.z };
+
+        unsigned int outIdx = cached.vertexRemap.empty() ? vertIdx : cached.vertexRemap[vertIdx];
+        if (m_VertexFormat == FLOAT_VERTEX)
+            std::memcpy(vertexBytes + vertexSize * outIdx, vertex, sizeof(vertex));
+        else
+            PackVertex(vertex, vertexBytes + vertexSize * outIdx);
+        outVertices.push_back(outIdx);
+    }
+
+    // corners of the rewired faces, at their triangle in every order
+    unsigned int numTriangles = cached.numIdx / 3;
+    unsigned int numClusters = (numTriangles + VIEW_ORDER_CLUSTER_SIZE - 1) / VIEW_ORDER_CLUSTER_SIZE;
+    std::vector<unsigned int> outTriangles;
+    for (unsigned int faceIdx : rewiredFaces)
+    {
+        unsigned int corners[3];
+        for (unsigned int corner = 0; corner < 3; corner++)
         {
-            // x value of the vertex
-            m_OutVertices[6 * i + 0] = m_Object.m_VertexPos[i].x;
-            // y value of the vertex
-            m_OutVertices[6 * i + 1] = m_Object.m_VertexPos[i].y;
-            // z value of the vertex
-            m_OutVertices[6 * i + 2] = m_Object.m_VertexPos[i].z;
-
-            // x value of the normal
-            m_OutVertices[6 * i + 3] = smoothVertexNormals[i].x;
-            // y value of the normal
-            m_OutVertices[6 * i + 4] = smoothVertexNormals[i].y;
-            // z value of the normal
-            m_OutVertices[6 * i + 5] = smoothVertexNormals[i].z;
+            unsigned int vertIdx = m_Object.m_TriFaceIndices[faceIdx][corner];
+            corners[corner] = cached.vertexRemap.empty() ? vertIdx : cached.vertexRemap[vertIdx];
         }
 
-        // build out IBO indices
-        m_OutNumIdx = 3 * numFaces;
-        m_OutIndices = new unsigned int[m_OutNumIdx];
-        for (unsigned int i = 0; i < numFaces; i++)
+        unsigned int triangle = cached.faceTriangles[faceIdx];
+        for (unsigned int order = 0; order < cached.numOrders; order++)
         {
-            m_OutIndices[3 * i + 0] = m_Object.m_TriFaceIndices[i][0];
-            m_OutIndices[3 * i + 1] = m_Object.m_TriFaceIndices[i][1];
-            m_OutIndices[3 * i + 2] = m_Object.m_TriFaceIndices[i][2];
+            unsigned int slot = triangle;
+            if (order > 0)
+                slot = cached.viewClusterStarts[(order - 1) * numClusters + triangle / VIEW_ORDER_CLUSTER_SIZE] + triangle % VIEW_ORDER_CLUSTER_SIZE;
+            slot += order * numTriangles;
+
+            std::copy(corners, corners + 3, cached.indices + 3 * slot);
+            outTriangles.push_back(slot);
         }
     }
+
+    // a new edit on another shading cannot extend the old ranges
+    if ((!m_DirtyRanges.empty() || !m_DirtyIndexRanges.empty()) && m_DirtyShading != BufferShading(m_ShadingType))
+        ClearDirtyRanges();
+    if (m_DirtyRanges.empty() && m_DirtyIndexRanges.empty())
+    {
+        m_DirtyFromVersion = m_Version;
+        m_DirtyShading = BufferShading(m_ShadingType);
+    }
+
+    const unsigned int MAX_GAP = 8; // vertices or triangles
+    AppendRanges(outVertices, MAX_GAP, vertexSize, m_DirtyRanges);
+    AppendRanges(outTriangles, MAX_GAP, 3, m_DirtyIndexRanges);
+
+    m_Version++;
+}
+
+void Mesh::ClearDirtyRanges()
+{
+    m_DirtyRanges.clear();
+    m_DirtyIndexRanges.clear();
 }
 
 void Mesh::Destroy()
 {
     m_FaceNormals.clear();
+    m_VertFaceOffsets.clear();
+    m_VertFaceCounts.clear();
+    m_VertFaces.clear();
 
-    delete[] m_OutVertices;
-    delete[] m_OutIndices;
+    for (MeshBuffers& cached : m_Cached)
+    {
+        delete[] cached.vertexData;
+        delete[] cached.indices;
+        cached = MeshBuffers{};
+    }
+    ClearDirtyRanges();
+    m_OutNumVert = 0; m_OutVertices = nullptr;
+    m_OutVertexBytes = 0; m_OutVertexData = nullptr;
+    m_OutNumIdx = 0; m_OutNumOrders = 1; m_OutIndices = nullptr;
 }
 
 void Mesh::Rebuild()
 {
     Destroy();
+    m_Version++;
     BuildFaceNormals();
-    BuildVerticesIndices();
+    BuildVertexAdjacency();
+    Rebuild(m_ShadingType);
 }
 
 void Mesh::Rebuild(Object obj)
 {
+    // the reserved pairs belong to the previous object
     m_Object = obj;
+    m_ReservedAdjacency.clear();
     Rebuild();
 }
 
+void Mesh::Replace(Mesh& other)
+{
+    // the other mesh ends up with the previous buffers and frees them
+    std::swap(m_Object, other.m_Object);
+    std::swap(m_ShadingType, other.m_ShadingType);
+    std::swap(m_VertexFormat, other.m_VertexFormat);
+    std::swap(m_PackedFormat, other.m_PackedFormat);
+    std::swap(m_ReorderVertices, other.m_ReorderVertices);
+    std::swap(m_ViewOrders, other.m_ViewOrders);
+    std::swap(m_FaceNormals, other.m_FaceNormals);
+    std::swap(m_VertFaceOffsets, other.m_VertFaceOffsets);
+    std::swap(m_VertFaceCounts, other.m_VertFaceCounts);
+    std::swap(m_VertFaces, other.m_VertFaces);
+    std::swap(m_ReservedAdjacency, other.m_ReservedAdjacency);
+    std::swap(m_Cached, other.m_Cached);
+    std::swap(m_OutNumVert, other.m_OutNumVert);
+    std::swap(m_OutVertices, other.m_OutVertices);
+    std::swap(m_OutVertexBytes, other.m_OutVertexBytes);
+    std::swap(m_OutVertexData, other.m_OutVertexData);
+    std::swap(m_OutNumIdx, other.m_OutNumIdx);
+    std::swap(m_OutNumOrders, other.m_OutNumOrders);
+    std::swap(m_OutIndices, other.m_OutIndices);
+    std::swap(m_OutVertexRemap, other.m_OutVertexRemap);
+    std::swap(m_OutFaceTriangles, other.m_OutFaceTriangles);
+    std::swap(m_OutViewClusterStarts, other.m_OutViewClusterStarts);
+    std::swap(m_ACMRBefore, other.m_ACMRBefore);
+    std::swap(m_ACMRAfter, other.m_ACMRAfter);
+    std::swap(m_MaxPositionError, other.m_MaxPositionError);
+    std::swap(m_MaxNormalError, other.m_MaxNormalError);
+
+    // a version this mesh never had, so the GPU buffers of the previous object are not reused
+    m_Version = std::max(m_Version, other.m_Version) + 1;
+    ClearDirtyRanges();
+    m_DirtyFromVersion = m_Version;
+    m_DirtyShading = BufferShading(m_ShadingType);
+}
+
 void Mesh::Rebuild(int shading)
 {
+    // the object did not change, each shading type is built on first use and kept until it does
     m_ShadingType = shading;
-    Rebuild();
+
+    MeshBuffers& cached = m_Cached[BufferShading(shading)];
+    if (!cached.vertexData)
+    {
+        BuildVerticesIndices();
+        cached.vertexData = PackVertices();
+        cached.vertexBytes = m_OutVertexBytes;
+        cached.numIdx = m_OutNumIdx; cached.numOrders = m_OutNumOrders; cached.indices = m_OutIndices;
+        cached.acmrBefore = m_ACMRBefore; cached.acmrAfter = m_ACMRAfter;
+        cached.vertexRemap.swap(m_OutVertexRemap);
+        cached.faceTriangles.swap(m_OutFaceTriangles);
+        cached.viewClusterStarts.swap(m_OutViewClusterStarts);
+    }
+
+    m_OutVertexBytes = cached.vertexBytes; m_OutVertexData = cached.vertexData;
+    m_OutNumIdx = cached.numIdx; m_OutNumOrders = cached.numOrders; m_OutIndices = cached.indices;
+    m_ACMRBefore = cached.acmrBefore; m_ACMRAfter = cached.acmrAfter;
+    if (m_VertexFormat == FLOAT_VERTEX)
+    {
+        m_OutNumVert = cached.vertexBytes / sizeof(float);
+        m_OutVertices = cached.vertexData;
+    }
+    else
+    {
+        m_OutNumVert = 0;
+        m_OutVertices = nullptr;
+    }
+}
+
+void Mesh::Evict(int shading)
+{
+    if (BufferShading(shading) == BufferShading(m_ShadingType))
+        return;
+
+    MeshBuffers& cached = m_Cached[BufferShading(shading)];
+    delete[] cached.vertexData;
+    delete[] cached.indices;
+    cached = MeshBuffers{};
+}
+
+bool Mesh::IsCached(int shading) const
+{
+    return m_Cached[BufferShading(shading)].vertexData != nullptr;
+}
+
+unsigned long long Mesh::GetCachedBytes(int shading) const
+{
+    const MeshBuffers& cached = m_Cached[BufferShading(shading)];
+    return static_cast<unsigned long long>(cached.vertexBytes) + static_cast<unsigned long long>(cached.numIdx) * cached.numOrders * sizeof(unsigned int);
+}
+
+void Mesh::SetVertexFormat(int format)
+{
+    if (format == m_VertexFormat)
+        return;
+
+    m_VertexFormat = format;
+    DropOutputs();
+}
+
+void Mesh::SetViewOrders(bool enabled)
+{
+    if (enabled == m_ViewOrders)
+        return;
+
+    m_ViewOrders = enabled;
+    DropOutputs();
+}
+
+void Mesh::DropOutputs()
+{
+    // face normals and adjacency stay, only the output buffers are dropped
+    for (MeshBuffers& cached : m_Cached)
+    {
+        delete[] cached.vertexData;
+        delete[] cached.indices;
+        cached = MeshBuffers{};
+    }
+    ClearDirtyRanges();
+    m_Version++;
+    Rebuild(m_ShadingType);
+}
+
+unsigned int Mesh::SelectViewOrder(glm::vec3 viewDir) const
+{
+    if (m_OutNumOrders <= 1)
+        return 0;
+
+    // the precomputed direction closest to viewDir
+    unsigned int best = 0;
+    float bestCos = -2.0f;
+    for (unsigned int view = 0; view < NUM_VIEW_ORDERS; view++)
+    {
+        float cosine = glm::dot(glm::normalize(VIEW_DIRECTIONS[view]), viewDir);
+        if (cosine > bestCos)
+        {
+            bestCos = cosine;
+            best = view;
+        }
+    }
+    return 1 + best;
+}
+
+unsigned int Mesh::GetVertexSize(int format)
+{
+    return format == FLOAT_VERTEX ? 6 * sizeof(float) : 12;
 }
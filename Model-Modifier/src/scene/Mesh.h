@@ -4,9 +4,13 @@
 #include <unordered_map>
 
 #include "../external/glm/ext/vector_float3.hpp"
+#include "../external/glm/ext/vector_uint2.hpp"
 #include "../external/glm/geometric.hpp"
+#include "../external/glm/gtc/packing.hpp"
 
 #include "object/Object.h"
+#include "util/ParallelFor.h"
+#include "util/VertexCache.h"
 
 enum shading
 {
@@ -14,29 +18,144 @@ enum shading
 	MIXED,
 	SMOOTH
 };
+const unsigned int NUM_SHADING_TYPES = 3;
+
+// shading type whose buffers a shading draws from, flat normals come from screen space derivatives
+// so flat shading draws the smooth buffers
+inline int BufferShading(int shading)
+{
+	return shading == FLAT ? SMOOTH : shading;
+}
+
+// layout of the output vertices, the objects are rescaled to [-1, 1] so positions fit normalized integers
+enum vertexFormat
+{
+	FLOAT_VERTEX, // float3 position, float3 normal: 24 bytes
+	SNORM16_VERTEX, // 16 bit normalized position (w padding), 2_10_10_10 normalized normal: 12 bytes
+	HALF_VERTEX // 16 bit float position (w padding), 2_10_10_10 normalized normal: 12 bytes
+};
+
+// view directions with a precomputed front-to-back triangle order: the 6 axes and the 8 diagonals
+const unsigned int NUM_VIEW_ORDERS = 14;
+
+// output buffers of one shading type
+struct MeshBuffers
+{
+	unsigned int vertexBytes = 0;
+	float* vertexData = nullptr; // 4 byte words, holding packed vertices in the other formats
+	std::vector<unsigned int> vertexRemap; // output vertex of each object vertex when they were renumbered
+
+	unsigned int numIdx = 0; // per triangle order
+	unsigned int numOrders = 1;
+	unsigned int* indices = nullptr;
+	// where edits rewrite the corners of a face: its triangle in the base order,
+	// and the first triangle of every cluster in each view order
+	std::vector<unsigned int> faceTriangles;
+	std::vector<unsigned int> viewClusterStarts;
+
+	// average cache miss ratio of the indices as built and after optimization
+	float acmrBefore = 0.0f;
+	float acmrAfter = 0.0f;
+};
 
 class Mesh
 {
 public:
-	Mesh(Object obj, int shading);
+	// reorderVertices lets the optimization renumber the output vertices,
+	// disable it when outside indices refer to the vertices of the object
+	Mesh(Object obj, int shading, int format = FLOAT_VERTEX, bool reorderVertices = true);
 	~Mesh();
 
 	void BuildFaceNormals();
+	void BuildVertexAdjacency();
+	// keep room in the adjacency for vertex-face pairs (vertex, face) that later topology edits create
+	void ReserveAdjacency(std::vector<glm::uvec2> pairs);
 
 	void BuildVerticesIndices();
+	void OptimizeVerticesIndices();
+	void BuildViewOrders();
+	// convert the float vertices to the vertex format, returns the storage of the result
+	float* PackVertices();
+	void PackVertex(const float* vertex, unsigned char* packed) const;
+	// every position of the float vertices (6 floats each) within [-1, 1]
+	static bool InSnormRange(const float* vertices, unsigned int numVertices);
 	void Destroy();
+	void DropOutputs();
 	void Rebuild();
 	void Rebuild(Object obj);
 	void Rebuild(int shading);
+	// take over the object and buffers of a mesh built elsewhere (on a worker thread), as a new version of this one
+	void Replace(Mesh& other);
+
+	// drop the cached buffers of a shading type not sharing the buffers of the current one
+	void Evict(int shading);
+	bool IsCached(int shading) const;
+	unsigned long long GetCachedBytes(int shading) const;
+
+	// local edit: the caller moved dirtyVertices in m_Object and rewrote the corners of rewiredFaces,
+	// a face repeating one vertex is removed, every vertex that lost a face must be in dirtyVertices
+	// and every pair a rewired face creates must have been reserved, the vertex count never changes
+	// only the faces around them and their one-rings are recomputed, the changed ranges are kept in m_DirtyRanges and m_DirtyIndexRanges
+	// mixed shading regroups its fans over the whole mesh and is rebuilt instead, it is not meant for editing
+	void Update(const std::vector<unsigned int>& dirtyVertices, const std::vector<unsigned int>& rewiredFaces = {});
+	void ClearDirtyRanges();
+
+	// switching format drops every cached buffer, like a new version of the object
+	void SetVertexFormat(int format);
+	static unsigned int GetVertexSize(int format);
+
+	// front-to-back triangle orders for a set of view directions, appended after the base order of the indices
+	void SetViewOrders(bool enabled);
+	// order to draw when looking along viewDir (object space), 0 is the base order
+	unsigned int SelectViewOrder(glm::vec3 viewDir) const;
 
 public:
 	Object m_Object;
 	int m_ShadingType;
+	unsigned int m_Version; // bumped every time the object, an edit or the vertex format changes
+	int m_VertexFormat;
+	// format the buffers are packed in: m_VertexFormat, or half floats while positions leave the snorm16 range
+	int m_PackedFormat;
+	bool m_ReorderVertices;
+	bool m_ViewOrders;
 
 	std::vector<glm::vec3> m_FaceNormals;
 
+	// vertex-face adjacency in CSR form: faces of vertex i are m_VertFaces[m_VertFaceOffsets[i] .. m_VertFaceOffsets[i] + m_VertFaceCounts[i]),
+	// the rest of its range up to m_VertFaceOffsets[i + 1] holds the reserved pairs not in use
+	// face normals and adjacency only depend on the object, a shading change reuses them
+	std::vector<unsigned int> m_VertFaceOffsets;
+	std::vector<unsigned int> m_VertFaceCounts;
+	std::vector<unsigned int> m_VertFaces;
+	std::vector<glm::uvec2> m_ReservedAdjacency; // sorted, kept until the object is replaced
+
+	// buffers of every shading type built so far for this version, m_Out* point into the current one
+	// indexed by BufferShading, the flat entry stays empty
+	MeshBuffers m_Cached[NUM_SHADING_TYPES];
+
+	// float vertices are only available with FLOAT_VERTEX, every format is uploaded from m_OutVertexData
 	unsigned int m_OutNumVert;
 	float* m_OutVertices;
+	unsigned int m_OutVertexBytes;
+	const void* m_OutVertexData;
+	// m_OutIndices holds m_OutNumOrders triangle orders of m_OutNumIdx indices each
 	unsigned int m_OutNumIdx;
+	unsigned int m_OutNumOrders;
 	unsigned int* m_OutIndices;
+	std::vector<unsigned int> m_OutVertexRemap;
+	std::vector<unsigned int> m_OutFaceTriangles;
+	std::vector<unsigned int> m_OutViewClusterStarts;
+	float m_ACMRBefore;
+	float m_ACMRAfter;
+
+	// byte ranges (offset, size) of the vertex buffer of m_DirtyShading changed by edits since m_DirtyFromVersion,
+	// and index ranges (first, count) of its index buffer, every triangle order included
+	std::vector<std::pair<unsigned int, unsigned int>> m_DirtyRanges;
+	std::vector<std::pair<unsigned int, unsigned int>> m_DirtyIndexRanges;
+	unsigned int m_DirtyFromVersion;
+	int m_DirtyShading;
+
+	// largest position and normal error of the last packed buffer against the float one
+	float m_MaxPositionError;
+	float m_MaxNormalError;
 };
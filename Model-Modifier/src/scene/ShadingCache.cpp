@@ -0,0 +1,178 @@
+#include "ShadingCache.h"
+
+#include <cstdint>
+
+ShadingCache::ShadingCache(unsigned long long budgetBytes)
+    : m_Mode(DRAW_MODE::STATIC), m_Bound(-1), m_UseCounter(0), m_Budget(budgetBytes)
+{
+}
+
+void ShadingCache::Bind(Mesh& mesh, int shading, const VertexBufferLayout& layout)
+{
+    // flat and smooth shading draw from the same entry
+    int slot = BufferShading(shading);
+
+    // buffers of an older object are useless, the current shading reuses its buffer names
+    for (unsigned int i = 0; i < NUM_SHADING_TYPES; i++)
+    {
+        if (static_cast<int>(i) != slot && m_Entries[i].vertexArray && m_Entries[i].version != mesh.m_Version)
+            m_Entries[i] = ShadingBuffers{};
+    }
+
+    ShadingBuffers& entry = m_Entries[slot];
+    if (!entry.vertexArray || entry.version != mesh.m_Version)
+    {
+        mesh.Rebuild(shading); // only builds the CPU buffers the first time for this version
+
+        // local edits since the last upload only rewrite the bytes they changed
+        if (entry.vertexArray && slot == mesh.m_DirtyShading && entry.version == mesh.m_DirtyFromVersion &&
+            (!mesh.m_DirtyRanges.empty() || !mesh.m_DirtyIndexRanges.empty()))
+        {
+            Patch(mesh, slot, layout);
+        }
+        else
+        {
+            Upload(mesh, slot, layout);
+            Evict(mesh, slot);
+        }
+        mesh.ClearDirtyRanges();
+    }
+    else if (mesh.m_ShadingType != shading)
+    {
+        mesh.Rebuild(shading);
+    }
+
+    entry.lastUse = ++m_UseCounter;
+    entry.vertexArray->Bind();
+    entry.indexBuffer->Bind(); // shared levels of detail swap in their own index buffer
+    m_Bound = slot;
+}
+
+void ShadingCache::Clear()
+{
+    for (ShadingBuffers& entry : m_Entries)
+    {
+        entry = ShadingBuffers{};
+    }
+    m_Bound = -1;
+}
+
+void ShadingCache::SetDrawMode(DRAW_MODE mode)
+{
+    if (mode == m_Mode)
+        return;
+
+    m_Mode = mode;
+    Clear();
+}
+
+void ShadingCache::Upload(Mesh& mesh, int shading, const VertexBufferLayout& layout)
+{
+    ShadingBuffers& entry = m_Entries[shading];
+
+    // packed and float vertices share the path, the layout follows the vertex format of the mesh
+    if (entry.vertexArray)
+    {
+        entry.vertexArray->Bind();
+        entry.vertexBuffer->AssignData(mesh.m_OutVertexData, mesh.m_OutVertexBytes, m_Mode);
+        entry.vertexArray->AddBuffer(*entry.vertexBuffer, layout);
+        entry.indexBuffer->AssignData(mesh.m_OutIndices, mesh.m_OutNumIdx * mesh.m_OutNumOrders, m_Mode);
+    }
+    else
+    {
+        entry.vertexArray = std::make_unique<VertexArray>();
+        entry.vertexBuffer = std::make_unique<VertexBuffer>(mesh.m_OutVertexData, mesh.m_OutVertexBytes, m_Mode);
+        entry.vertexArray->AddBuffer(*entry.vertexBuffer, layout);
+        entry.indexBuffer = std::make_unique<IndexBuffer>(mesh.m_OutIndices, mesh.m_OutNumIdx * mesh.m_OutNumOrders, m_Mode);
+    }
+
+    entry.drawCount = mesh.m_OutNumIdx;
+    entry.version = mesh.m_Version;
+    entry.bytes = mesh.GetCachedBytes(shading);
+}
+
+void ShadingCache::Patch(Mesh& mesh, int shading, const VertexBufferLayout& layout)
+{
+    ShadingBuffers& entry = m_Entries[shading];
+
+    // the index buffer binding belongs to the vertex array, it must be the bound one
+    entry.vertexArray->Bind();
+
+    // the next region of a streamed buffer holds older data, it gets all the vertices and indices
+    if (m_Mode == DRAW_MODE::STREAM)
+    {
+        entry.vertexBuffer->AssignData(mesh.m_OutVertexData, mesh.m_OutVertexBytes, m_Mode);
+        entry.vertexArray->AddBuffer(*entry.vertexBuffer, layout);
+        if (!mesh.m_DirtyIndexRanges.empty())
+            entry.indexBuffer->AssignData(mesh.m_OutIndices, mesh.m_OutNumIdx * mesh.m_OutNumOrders, m_Mode);
+        entry.version = mesh.m_Version;
+        return;
+    }
+
+    const unsigned char* vertexBytes = static_cast<const unsigned char*>(mesh.m_OutVertexData);
+    for (std::pair<unsigned int, unsigned int> range : mesh.m_DirtyRanges)
+    {
+        entry.vertexBuffer->AssignSubData(vertexBytes + range.first, range.first, range.second);
+    }
+    for (std::pair<unsigned int, unsigned int> range : mesh.m_DirtyIndexRanges)
+    {
+        if (!entry.indexBuffer->AssignSubData(mesh.m_OutIndices + range.first, range.first, range.second))
+        {
+            entry.indexBuffer->AssignData(mesh.m_OutIndices, mesh.m_OutNumIdx * mesh.m_OutNumOrders, m_Mode);
+            break;
+        }
+    }
+
+    entry.version = mesh.m_Version;
+}
+
+void ShadingCache::Evict(Mesh& mesh, int keep)
+{
+    // the shading in use is never evicted, whatever its size
+    while (GetUsedBytes(mesh) > m_Budget)
+    {
+        int oldest = -1;
+        for (unsigned int i = 0; i < NUM_SHADING_TYPES; i++)
+        {
+            if (static_cast<int>(i) == keep || BufferShading(i) != static_cast<int>(i) || (!m_Entries[i].vertexArray && !mesh.IsCached(i)))
+                continue;
+            if (oldest < 0 || m_Entries[i].lastUse < m_Entries[oldest].lastUse)
+                oldest = static_cast<int>(i);
+        }
+        if (oldest < 0)
+            break;
+
+        m_Entries[oldest] = ShadingBuffers{};
+        mesh.Evict(oldest);
+    }
+}
+
+unsigned int ShadingCache::GetCount() const
+{
+    return m_Bound >= 0 ? m_Entries[m_Bound].drawCount : 0;
+}
+
+unsigned int ShadingCache::GetIndexType() const
+{
+    return m_Bound >= 0 ? m_Entries[m_Bound].indexBuffer->GetType() : GL_UNSIGNED_INT;
+}
+
+const void* ShadingCache::GetIndexOffset(unsigned int order) const
+{
+    if (m_Bound < 0)
+        return nullptr;
+
+    const ShadingBuffers& entry = m_Entries[m_Bound];
+    return reinterpret_cast<const void*>(entry.indexBuffer->GetOffset() + static_cast<intptr_t>(order) * entry.drawCount * entry.indexBuffer->GetSizeOfIndex());
+}
+
+unsigned long long ShadingCache::GetUsedBytes(const Mesh& mesh) const
+{
+    unsigned long long used = 0;
+    for (unsigned int i = 0; i < NUM_SHADING_TYPES; i++)
+    {
+        if (BufferShading(i) == static_cast<int>(i)) // flat is counted with smooth
+            used += m_Entries[i].bytes + mesh.GetCachedBytes(i);
+    }
+    return used;
+}
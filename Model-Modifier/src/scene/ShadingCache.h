@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+
+#include "../renderer/VertexArray.h"
+#include "../renderer/VertexBuffer.h"
+#include "../renderer/IndexBuffer.h"
+#include "../renderer/VertexBufferLayout.h"
+
+#include "Mesh.h"
+
+// GPU buffers of one shading type, uploaded from the matching Mesh buffers
+struct ShadingBuffers
+{
+	std::unique_ptr<VertexArray> vertexArray;
+	std::unique_ptr<VertexBuffer> vertexBuffer;
+	std::unique_ptr<IndexBuffer> indexBuffer;
+
+	unsigned int drawCount = 0; // indices of one triangle order
+	unsigned int version = 0; // Mesh version the buffers were uploaded from
+	unsigned long long bytes = 0;
+	unsigned long long lastUse = 0;
+};
+
+// keeps the vertex arrays of every shading type of a mesh, so switching shading only binds another one
+// entries are built lazily, refreshed when the mesh version changes and evicted least recently used first
+// once the CPU and GPU copies together go over the memory budget
+class ShadingCache
+{
+public:
+	ShadingCache(unsigned long long budgetBytes = 512ull << 20);
+
+	// make sure the buffers of shading are current, then bind its vertex array
+	void Bind(Mesh& mesh, int shading, const VertexBufferLayout& layout);
+	void Clear();
+	// STREAM keeps the buffers persistently mapped, for meshes rewritten every few frames
+	void SetDrawMode(DRAW_MODE mode);
+
+	unsigned int GetCount() const;
+	unsigned int GetIndexType() const;
+	// offset of a triangle order in the bound index buffer, as passed to glDrawElements
+	const void* GetIndexOffset(unsigned int order) const;
+	unsigned long long GetUsedBytes(const Mesh& mesh) const;
+
+private:
+	void Upload(Mesh& mesh, int shading, const VertexBufferLayout& layout);
+	// rewrite the vertex and index ranges changed by local edits of the mesh
+	void Patch(Mesh& mesh, int shading, const VertexBufferLayout& layout);
+	void Evict(Mesh& mesh, int keep);
+
+private:
+	ShadingBuffers m_Entries[NUM_SHADING_TYPES]; // indexed by BufferShading
+	DRAW_MODE m_Mode;
+	int m_Bound;
+	unsigned long long m_UseCounter;
+	unsigned long long m_Budget;
+};
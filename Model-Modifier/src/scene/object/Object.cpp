@@ -90,6 +90,30 @@ void Object::loadOBJ(const std::string &filename)
     }
 }
 
+void Object::saveOBJ(const std::string &filename) const
+{
+    std::ofstream out(filename);
+    if (!out)
+    {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return;
+    }
+
+    for (glm::vec3 v : m_VertexPos)
+    {
+        out << "v " << v.x << " " << v.y << " " << v.z << "\n";
+    }
+    for (const std::vector<unsigned int>& face : m_FaceIndices)
+    {
+        out << "f";
+        for (unsigned int vertIdx : face)
+        {
+            out << " " << vertIdx + 1; // obj indices start at 1
+        }
+        out << "\n";
+    }
+}
+
 void Object::Rescale()
 {
     glm::vec3 lengths = m_Max - m_Min;
@@ -125,12 +149,24 @@ void Object::Reload(const std::string &filename)
     Rescale();
 }
 
-void Object::TriangulateFaces()
+void Object::TriangulateFaces(Progress* progress)
 {
     std::vector<std::vector<unsigned int>> triFaces;
 
+    if (progress)
+        progress->BeginStage("Triangulating", static_cast<unsigned int>(m_FaceIndices.size()));
     for (unsigned int i = 0; i < m_FaceIndices.size(); i++)
     {
+        if (progress)
+        {
+            if (progress->IsCancelled())
+            {
+                m_TriFaceIndices.clear();
+                return;
+            }
+            progress->Report(i);
+        }
+
         if (m_FaceIndices[i].size() == 3)
             triFaces.push_back(m_FaceIndices[i]);
         else if (m_FaceIndices[i].size() > 3)
@@ -10,6 +10,7 @@
 #include "../../external/glm/ext/vector_float3.hpp"
 #include "../../external/glm/geometric.hpp"
 #include "../util/Triangulate.h"
+#include "../util/Progress.h"
 
 class Object
 {
@@ -19,11 +20,13 @@ public:
 	~Object();
 
 	void loadOBJ(const std::string &filename);
+	void saveOBJ(const std::string &filename) const;
 	void Rescale();
 	void Destroy();
 	void Reload(const std::string &filename);
 
-	void TriangulateFaces();
+	// progress is polled once per face, a cancelled run leaves no triangles
+	void TriangulateFaces(Progress* progress = nullptr);
 
 	void MakeTriangleMesh();
 
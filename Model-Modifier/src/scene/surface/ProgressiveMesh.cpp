@@ -0,0 +1,279 @@
+#include "ProgressiveMesh.h"
+
+#include <algorithm>
+
+ProgressiveMesh::ProgressiveMesh()
+    : m_Min(0), m_Max(0), m_NumApplied(0), m_NumFaces(0), m_MaxFaces(0)
+{
+}
+
+ProgressiveMesh::ProgressiveMesh(const std::vector<glm::vec3>& vertexPos, const std::vector<glm::uvec3>& faces, glm::vec3 min, glm::vec3 max)
+    : m_Min(min), m_Max(max), m_VertexPos(vertexPos), m_Faces(faces), m_NumApplied(0)
+{
+    m_NumFaces = static_cast<unsigned int>(faces.size());
+    m_MaxFaces = m_NumFaces;
+    m_FaceAlive.assign(faces.size(), true);
+}
+
+ProgressiveMesh::~ProgressiveMesh()
+{
+}
+
+void ProgressiveMesh::AddRecord(const VertexSplitRecord& record)
+{
+    m_Records.push_back(record);
+}
+
+bool ProgressiveMesh::Collapse()
+{
+    if (m_NumApplied >= m_Records.size())
+        return false;
+
+    const VertexSplitRecord& record = m_Records[m_NumApplied];
+    MarkChanged(record);
+    m_VertexPos[record.vertKept] = record.newPosition;
+    for (unsigned int faceIdx : record.removedFaces)
+    {
+        m_FaceAlive[faceIdx] = false;
+    }
+    for (unsigned int i = 0; i < record.changedFaces.size(); i++)
+    {
+        m_Faces[record.changedFaces[i]] = record.newCorners[i];
+    }
+    m_NumFaces = record.numFaces;
+    m_NumApplied++;
+
+    return true;
+}
+
+bool ProgressiveMesh::Split()
+{
+    if (m_NumApplied == 0)
+        return false;
+
+    m_NumApplied--;
+    const VertexSplitRecord& record = m_Records[m_NumApplied];
+    MarkChanged(record);
+    m_VertexPos[record.vertKept] = record.keptPosition;
+    for (unsigned int faceIdx : record.removedFaces)
+    {
+        m_FaceAlive[faceIdx] = true;
+    }
+    for (unsigned int i = 0; i < record.changedFaces.size(); i++)
+    {
+        m_Faces[record.changedFaces[i]] = record.oldCorners[i];
+    }
+    m_NumFaces = (m_NumApplied == 0) ? m_MaxFaces : m_Records[m_NumApplied - 1].numFaces;
+
+    return true;
+}
+
+void ProgressiveMesh::SetFaceCount(unsigned int desiredCount)
+{
+    // coarsen until we are within the budget
+    while (m_NumFaces > desiredCount && Collapse())
+    {
+    }
+
+    // refine while the previous state still fits in the budget
+    while (m_NumApplied > 0)
+    {
+        unsigned int prevNumFaces = (m_NumApplied == 1) ? m_MaxFaces : m_Records[m_NumApplied - 2].numFaces;
+        if (prevNumFaces > desiredCount)
+            break;
+        Split();
+    }
+}
+
+Object ProgressiveMesh::GetObject() const
+{
+    // only keep vertices that are referenced by a living face
+    const unsigned int UNUSED = 0xFFFFFFFF;
+    std::vector<unsigned int> newVertIdx(m_VertexPos.size(), UNUSED);
+
+    std::vector<glm::vec3> VertexPos;
+    std::vector<std::vector<unsigned int>> FaceIndices;
+    FaceIndices.reserve(m_NumFaces);
+
+    for (unsigned int i = 0; i < m_Faces.size(); i++)
+    {
+        if (!m_FaceAlive[i])
+            continue;
+
+        std::vector<unsigned int> vertsIdx(3);
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            unsigned int vert = m_Faces[i][j];
+            if (newVertIdx[vert] == UNUSED)
+            {
+                newVertIdx[vert] = static_cast<unsigned int>(VertexPos.size());
+                VertexPos.push_back(m_VertexPos[vert]);
+            }
+            vertsIdx[j] = newVertIdx[vert];
+        }
+        FaceIndices.push_back(vertsIdx);
+    }
+
+    // build object
+    Object Obj;
+    Obj.m_Min = m_Min; Obj.m_Max = m_Max;
+    Obj.m_VertexPos = VertexPos; Obj.m_FaceIndices = FaceIndices;
+    Obj.m_TriFaceIndices = FaceIndices;
+    if (!FaceIndices.empty())
+        Obj.m_NumPolygons[3] = static_cast<unsigned int>(FaceIndices.size());
+
+    return Obj;
+}
+
+std::vector<unsigned int> ProgressiveMesh::GetIndices() const
+{
+    std::vector<unsigned int> indices;
+    indices.reserve(3 * m_NumFaces);
+    for (unsigned int i = 0; i < m_Faces.size(); i++)
+    {
+        if (!m_FaceAlive[i])
+            continue;
+
+        indices.push_back(m_Faces[i][0]);
+        indices.push_back(m_Faces[i][1]);
+        indices.push_back(m_Faces[i][2]);
+    }
+    return indices;
+}
+
+Object ProgressiveMesh::GetFullObject() const
+{
+    std::vector<std::vector<unsigned int>> FaceIndices(m_Faces.size());
+    for (unsigned int i = 0; i < m_Faces.size(); i++)
+    {
+        glm::uvec3 corners = GetCorners(i);
+        FaceIndices[i] = { corners[0], corners[1], corners[2] };
+    }
+
+    // build object
+    Object Obj;
+    Obj.m_Min = m_Min; Obj.m_Max = m_Max;
+    Obj.m_VertexPos = m_VertexPos; Obj.m_FaceIndices = FaceIndices;
+    Obj.m_TriFaceIndices = FaceIndices;
+    if (!FaceIndices.empty())
+        Obj.m_NumPolygons[3] = static_cast<unsigned int>(FaceIndices.size());
+
+    return Obj;
+}
+
+std::vector<glm::uvec2> ProgressiveMesh::GetAdjacency() const
+{
+    // a face has its original corners or the new corners of a record in any state,
+    // faces changed before this state had their original ones as old corners of their first change
+    std::vector<glm::uvec2> pairs;
+    pairs.reserve(3 * m_Faces.size());
+    for (unsigned int i = 0; i < m_Faces.size(); i++)
+    {
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            pairs.push_back({ m_Faces[i][j], i });
+        }
+    }
+    for (const VertexSplitRecord& record : m_Records)
+    {
+        for (unsigned int i = 0; i < record.changedFaces.size(); i++)
+        {
+            for (unsigned int j = 0; j < 3; j++)
+            {
+                pairs.push_back({ record.oldCorners[i][j], record.changedFaces[i] });
+                pairs.push_back({ record.newCorners[i][j], record.changedFaces[i] });
+            }
+        }
+    }
+    return pairs;
+}
+
+void ProgressiveMesh::TakeChanges(Object& obj, std::vector<unsigned int>& changedVertices, std::vector<unsigned int>& changedFaces)
+{
+    std::sort(m_ChangedVertices.begin(), m_ChangedVertices.end());
+    m_ChangedVertices.erase(std::unique(m_ChangedVertices.begin(), m_ChangedVertices.end()), m_ChangedVertices.end());
+    std::sort(m_ChangedFaces.begin(), m_ChangedFaces.end());
+    m_ChangedFaces.erase(std::unique(m_ChangedFaces.begin(), m_ChangedFaces.end()), m_ChangedFaces.end());
+
+    for (unsigned int vertIdx : m_ChangedVertices)
+    {
+        obj.m_VertexPos[vertIdx] = m_VertexPos[vertIdx];
+    }
+    for (unsigned int faceIdx : m_ChangedFaces)
+    {
+        glm::uvec3 corners = GetCorners(faceIdx);
+        obj.m_TriFaceIndices[faceIdx] = { corners[0], corners[1], corners[2] };
+        obj.m_FaceIndices[faceIdx] = obj.m_TriFaceIndices[faceIdx];
+    }
+
+    changedVertices.swap(m_ChangedVertices);
+    changedFaces.swap(m_ChangedFaces);
+    m_ChangedVertices.clear();
+    m_ChangedFaces.clear();
+}
+
+void ProgressiveMesh::MarkChanged(const VertexSplitRecord& record)
+{
+    // the corners before and after the step, so the vertices losing a face are in too
+    m_ChangedVertices.push_back(record.vertKept);
+    m_ChangedVertices.push_back(record.vertRemoved);
+    for (unsigned int faceIdx : record.removedFaces)
+    {
+        m_ChangedFaces.push_back(faceIdx);
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            m_ChangedVertices.push_back(m_Faces[faceIdx][j]);
+        }
+    }
+    for (unsigned int i = 0; i < record.changedFaces.size(); i++)
+    {
+        m_ChangedFaces.push_back(record.changedFaces[i]);
+        for (unsigned int j = 0; j < 3; j++)
+        {
+            m_ChangedVertices.push_back(record.oldCorners[i][j]);
+            m_ChangedVertices.push_back(record.newCorners[i][j]);
+        }
+    }
+}
+
+glm::uvec3 ProgressiveMesh::GetCorners(unsigned int faceIdx) const
+{
+    return m_FaceAlive[faceIdx] ? m_Faces[faceIdx] : glm::uvec3(m_Faces[faceIdx][0]);
+}
+
+float ProgressiveMesh::GetError() const
+{
+    float error = 0.0f;
+    for (unsigned int i = 0; i < m_NumApplied; i++)
+    {
+        error = std::max(error, m_Records[i].error);
+    }
+    return error;
+}
+
+unsigned int ProgressiveMesh::GetFaceCount() const
+{
+    return m_NumFaces;
+}
+
+unsigned int ProgressiveMesh::GetMaxFaceCount() const
+{
+    return m_MaxFaces;
+}
+
+unsigned int ProgressiveMesh::GetMinFaceCount() const
+{
+    // the last collapses may remove the final faces
+    unsigned int minFaces = m_MaxFaces;
+    for (const VertexSplitRecord& record : m_Records)
+    {
+        if (record.numFaces > 0)
+            minFaces = std::min(minFaces, record.numFaces);
+    }
+    return minFaces;
+}
+
+bool ProgressiveMesh::Empty() const
+{
+    return m_Records.empty();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "../../external/glm/ext/vector_float3.hpp"
+#include "../../external/glm/ext/vector_uint2.hpp"
+#include "../../external/glm/ext/vector_uint3.hpp"
+
+#include "../object/Object.h"
+
+// one recorded edge collapse, undoing it is a vertex split (Hoppe)
+struct VertexSplitRecord
+{
+	unsigned int vertKept; // vertex that survives the collapse
+	unsigned int vertRemoved; // vertex merged into vertKept
+	glm::vec3 keptPosition; // position of vertKept before the collapse
+	glm::vec3 newPosition; // position of vertKept after the collapse
+	std::vector<unsigned int> removedFaces; // faces that became degenerate
+	std::vector<unsigned int> changedFaces; // faces rewired onto vertKept (or flipped)
+	std::vector<glm::uvec3> oldCorners; // corners of changedFaces before the collapse
+	std::vector<glm::uvec3> newCorners; // corners of changedFaces after the collapse
+	unsigned int numFaces; // number of faces left after the collapse
+	float error; // quadric error of the collapse
+};
+
+class ProgressiveMesh
+{
+public:
+	ProgressiveMesh();
+	ProgressiveMesh(const std::vector<glm::vec3>& vertexPos, const std::vector<glm::uvec3>& faces, glm::vec3 min, glm::vec3 max);
+	~ProgressiveMesh();
+
+	void AddRecord(const VertexSplitRecord& record);
+
+	// step one record forward (edge collapse) or backward (vertex split)
+	bool Collapse();
+	bool Split();
+	// replay or undo collapses until the face count reaches desiredCount
+	void SetFaceCount(unsigned int desiredCount);
+
+	// compact the current state into an Object
+	Object GetObject() const;
+	// corners of the living faces, indexing the original vertices (only meaningful for half-edge collapses)
+	std::vector<unsigned int> GetIndices() const;
+	// every original vertex and face in the current state, removed faces repeat their first corner
+	// so a Mesh of it keeps the indices of the records and follows the steps through TakeChanges
+	Object GetFullObject() const;
+	// every vertex-face pair of any state, to reserve in the adjacency of that Mesh
+	std::vector<glm::uvec2> GetAdjacency() const;
+	// write the faces and vertices changed by the steps since the last call into obj, laid out like GetFullObject,
+	// and return them for Mesh::Update, the vertices that lost a face included
+	void TakeChanges(Object& obj, std::vector<unsigned int>& changedVertices, std::vector<unsigned int>& changedFaces);
+	// largest quadric error among the applied collapses
+	float GetError() const;
+
+	unsigned int GetFaceCount() const;
+	unsigned int GetMaxFaceCount() const;
+	// face count of the base mesh, the coarsest state that still has faces
+	unsigned int GetMinFaceCount() const;
+	bool Empty() const;
+
+private:
+	void MarkChanged(const VertexSplitRecord& record);
+	glm::uvec3 GetCorners(unsigned int faceIdx) const;
+
+public:
+	std::vector<VertexSplitRecord> m_Records;
+
+private:
+	glm::vec3 m_Min;
+	glm::vec3 m_Max;
+
+	std::vector<glm::vec3> m_VertexPos; // current vertex positions
+	std::vector<glm::uvec3> m_Faces; // current corners, indexed by original face
+	std::vector<bool> m_FaceAlive;
+
+	unsigned int m_NumApplied; // number of records currently applied
+	unsigned int m_NumFaces;
+	unsigned int m_MaxFaces;
+
+	// touched by the steps since the last TakeChanges, unsorted
+	std::vector<unsigned int> m_ChangedVertices;
+	std::vector<unsigned int> m_ChangedFaces;
+};
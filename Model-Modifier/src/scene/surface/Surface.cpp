@@ -64,9 +64,11 @@ unsigned int Surface::getEdgeIndex(glm::uvec2 vertPair)
     return newEdgeIdx;
 }
 
-Surface::Surface(Object obj)
-    : m_Min(obj.m_Min), m_Max(obj.m_Max)
+Surface::Surface(Object obj, Progress* progress)
+    : m_Min(obj.m_Min), m_Max(obj.m_Max), m_SimplifyError(0.0f), m_Progress(progress)
 {
+    BeginStage("Building adjacency", static_cast<unsigned int>(obj.m_FaceIndices.size()));
+
     for (glm::vec3 vertPos : obj.m_VertexPos)
     {
         // populate m_Vertices with obj.m_VertexPos data
@@ -77,6 +79,11 @@ Surface::Surface(Object obj)
 
     for (std::vector<unsigned int> faceVertices : obj.m_FaceIndices)
     {
+        // the algorithms check for cancellation first, a partial surface is never used
+        if (IsCancelled())
+            return;
+        ReportProgress(static_cast<unsigned int>(m_Faces.size()));
+
         unsigned int n = static_cast<unsigned int>(faceVertices.size());
 
         // create face record to be stored
@@ -125,7 +132,7 @@ Surface::~Surface()
 
 ////////// helper //////////
 
-glm::vec3 Surface::ComputeFaceNormal(FaceRecord face)
+glm::vec3 Surface::ComputeFaceNormal(const FaceRecord& face)
 {
     glm::vec3 pos0 = m_Vertices[face.verticesIdx[0]].position;
     glm::vec3 pos1 = m_Vertices[face.verticesIdx[1]].position;
@@ -137,3 +144,20 @@ glm::vec3 Surface::ComputeFaceNormal(glm::vec3 pos0, glm::vec3 pos1, glm::vec3 p
 {
     return glm::normalize(glm::cross(pos1 - pos0, pos2 - pos0));
 }
+
+bool Surface::IsCancelled() const
+{
+    return m_Progress && m_Progress->IsCancelled();
+}
+
+void Surface::BeginStage(const char* stage, unsigned int total)
+{
+    if (m_Progress)
+        m_Progress->BeginStage(stage, total);
+}
+
+void Surface::ReportProgress(unsigned int done)
+{
+    if (m_Progress)
+        m_Progress->Report(done);
+}
@@ -4,6 +4,7 @@
 #include <vector>
 #include <unordered_map>
 #include <queue>
+#include <limits>
 
 #include "../../external/glm/ext/vector_float3.hpp"
 #include "../../external/glm/ext/vector_uint2.hpp"
@@ -13,6 +14,9 @@
 #include "../object/Object.h"
 #include "../util/PlaneProjection.h"
 #include "../util/OrderVertices.h"
+#include "../util/ParallelFor.h"
+#include "../util/Progress.h"
+#include "ProgressiveMesh.h"
 
 struct VertexRecord
 {
@@ -51,14 +55,40 @@ struct ValidPair
 	float alpha;
 };
 
-struct CompareValidPairs
+// collapse heap entry, stamps detect entries made stale by later collapses
+struct CollapseCandidate
 {
-	bool operator()(const ValidPair& a, const ValidPair& b) const
+	ValidPair pair;
+	unsigned int stampOne;
+	unsigned int stampTwo;
+};
+
+struct CompareCollapseCandidates
+{
+	bool operator()(const CollapseCandidate& a, const CollapseCandidate& b) const
 	{
-		return a.error > b.error; // min heap
+		return a.pair.error > b.pair.error; // min heap
 	}
 };
 
+// plane and line quadrics of every vertex of an unmodified model, kept by the caller across Line QEM runs
+// so trying another alpha only reweights them, a run on other geometry computes them again
+struct QuadricCache
+{
+	unsigned long long geometryKey = 0; // hash of the positions and faces the quadrics come from
+	std::vector<glm::mat4> planeQuadrics;
+	std::vector<glm::mat4> lineQuadrics;
+};
+
+// targets of a multi-count QEM run, visited from the largest count to the smallest
+struct SnapshotTargets
+{
+	std::vector<unsigned int> counts; // as requested
+	std::vector<unsigned int> order; // indices into counts, largest count first
+	unsigned int next; // first target not reached yet
+	std::vector<Object> snapshots; // in the order of counts
+};
+
 class Surface
 {
 public:
@@ -69,12 +99,17 @@ public:
 	// if it does not exist, insert into our map and return
 	unsigned int getEdgeIndex(glm::uvec2 vertPair);
 
-	Surface(Object obj);
+	// progress is polled by the construction and by every algorithm, which then return empty objects once cancelled
+	Surface(Object obj, Progress* progress = nullptr);
 	~Surface();
 
 	// helper
-	glm::vec3 ComputeFaceNormal(FaceRecord face);
+	glm::vec3 ComputeFaceNormal(const FaceRecord& face);
 	glm::vec3 ComputeFaceNormal(glm::vec3 pos0, glm::vec3 pos1, glm::vec3 pos2);
+	// cancellation and progress of the running algorithm, no-ops without a Progress
+	bool IsCancelled() const;
+	void BeginStage(const char* stage, unsigned int total);
+	void ReportProgress(unsigned int done);
 	std::vector<glm::vec3> CatmulClarkEdgePoints();
 	Object CCOutputOBJ(std::vector<glm::vec3> edgePoints);
 	Object DSOutputOBJ(
@@ -84,15 +119,21 @@ public:
 	);
 	Object LoOutputOBJ(std::vector<glm::vec3> edgePoints);
 	// Shared QEM helpers
-	glm::mat4 ComputePlaneQuadric(VertexRecord v0);
+	std::vector<glm::vec3> ComputeFaceNormals();
+	std::vector<glm::mat4> ComputeVertexQuadrics();
 	glm::mat4 BuildQuadricSolverMatrix(const glm::mat4& Quad);
 	void ComputeOptimalVertexAndError(ValidPair& validPair, const glm::mat4& quadric1, const glm::mat4& quadric2);
+	void ComputeHalfEdgeCollapseAndError(ValidPair& validPair, const glm::mat4& quadric1, const glm::mat4& quadric2);
 	void UpdateAdjacencyIndices(std::vector<unsigned int>& adjFaces, const std::vector<unsigned int>& removedFaceIndices);
 	Object QEMOutputOBJ();  // shared output builder for both QEM variants
 	// Line Quadric specific helpers
 	glm::vec3 ComputeVertexNormal(VertexRecord v0);
-	glm::mat4 ComputeLineQuadric(VertexRecord v0);
+	std::vector<glm::mat4> ComputeLineQuadrics();
 	glm::mat4 ComputeWeightedQuadric(const glm::mat4& planeQuadric, const glm::mat4& lineQuadric, float alpha);
+	// fill the cache unless it already holds the quadrics of this surface
+	void PrecomputeQuadrics(QuadricCache& cache);
+	unsigned long long ComputeGeometryKey() const;
+	std::vector<glm::mat4> ComputeWeightedQuadrics(const QuadricCache& cache, float alpha);
 
 	// Modification algorithms
 	Object Beehive();
@@ -101,7 +142,16 @@ public:
 	Object DooSabin();
 	Object Loop();
 	Object QEM(unsigned int desiredCount);
-	Object LineQEM(unsigned int desiredCount, float alpha = 0.5f);
+	// cache, when given, keeps the precomputed quadrics of the model for the next run
+	Object LineQEM(unsigned int desiredCount, float alpha = 0.5f, QuadricCache* cache = nullptr);
+	// one run down to the smallest count, snapshotting the mesh as it passes each of desiredCounts
+	// the run also stops once the cheapest collapse left costs more than maxError (a quadric error)
+	std::vector<Object> QEM(const std::vector<unsigned int>& desiredCounts, float maxError = std::numeric_limits<float>::max());
+	std::vector<Object> LineQEM(const std::vector<unsigned int>& desiredCounts, float alpha = 0.5f, float maxError = std::numeric_limits<float>::max(), QuadricCache* cache = nullptr);
+	// collapse while the error stays within maxDistance, the quadric error is a sum of squared distances
+	Object QEMErrorBounded(float maxDistance);
+	// halfEdge only collapses onto existing vertices, so every level indexes the original vertex buffer
+	ProgressiveMesh BuildProgressiveMesh(bool halfEdge = false);
 
 public:
 	std::vector<VertexRecord> m_Vertices;
@@ -111,7 +161,20 @@ public:
 	glm::vec3 m_Min;
 	glm::vec3 m_Max;
 
+	// largest quadric error among the collapses applied by QEM/LineQEM
+	float m_SimplifyError;
+	// m_SimplifyError when each snapshot of a multi-target run was taken, in the order of desiredCounts
+	std::vector<float> m_SnapshotErrors;
+
 	std::unordered_map<unsigned int, std::unordered_map<unsigned int, unsigned int>> m_EdgeIdxLookup;
 private:
-	std::priority_queue<ValidPair, std::vector<ValidPair>, CompareValidPairs> m_QuadricErrorHeap;
+	// order the targets of a multi-count run and reset m_SnapshotErrors
+	SnapshotTargets SortTargets(const std::vector<unsigned int>& desiredCounts);
+	// compact the mesh for every target reached at numFaces, or for all the remaining ones once finished
+	void SnapshotReachedTargets(SnapshotTargets& targets, unsigned int numFaces, bool finished);
+
+private:
+	Progress* m_Progress;
+
+	std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, CompareCollapseCandidates> m_QuadricErrorHeap;
 };
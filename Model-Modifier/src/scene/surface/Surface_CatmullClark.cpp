@@ -35,8 +35,20 @@ Object Surface::CCOutputOBJ(std::vector<glm::vec3> edgePoints)
     std::vector<std::vector<unsigned int>> FaceIndices;
     std::unordered_map<unsigned int, unsigned int> NumberPolygons;
 
+    // every corner of a face becomes a quad
+    unsigned int expectedFaces = 0;
+    for (const FaceRecord& face : m_Faces)
+    {
+        expectedFaces += static_cast<unsigned int>(face.verticesIdx.size());
+    }
+    BeginStage("Emitting faces", expectedFaces);
+
     for (FaceRecord face : m_Faces)
     {
+        if (IsCancelled())
+            return Object();
+        ReportProgress(static_cast<unsigned int>(FaceIndices.size()));
+
         unsigned int n = static_cast<unsigned int>(face.verticesIdx.size());
         
         std::vector<unsigned int> vertsIdx;
@@ -66,7 +78,9 @@ Object Surface::CCOutputOBJ(std::vector<glm::vec3> edgePoints)
     Obj.m_Min = m_Min; Obj.m_Max = m_Max;
     Obj.m_VertexPos = VertexPos; Obj.m_FaceIndices = FaceIndices;
     Obj.m_NumPolygons = NumberPolygons;
-    Obj.TriangulateFaces();
+    Obj.TriangulateFaces(m_Progress);
+    if (IsCancelled())
+        return Object();
 
     return Obj;
 }
@@ -77,6 +91,9 @@ Object Surface::CCOutputOBJ(std::vector<glm::vec3> edgePoints)
 // My own algorithm
 Object Surface::Beehive()
 {
+    if (IsCancelled())
+        return Object();
+
     std::vector<glm::vec3> edgePoints = CatmulClarkEdgePoints();
 
     // update original vertex positions
@@ -103,6 +120,9 @@ Object Surface::Beehive()
 // My own algorithm
 Object Surface::Snowflake()
 {
+    if (IsCancelled())
+        return Object();
+
     std::vector<glm::vec3> edgePoints = CatmulClarkEdgePoints();
 
     // update original vertex positions
@@ -129,6 +149,9 @@ Object Surface::Snowflake()
 // Catmull Clark subdivision surface algorithm
 Object Surface::CatmullClark()
 {
+    if (IsCancelled())
+        return Object();
+
     std::vector<glm::vec3> edgePoints = CatmulClarkEdgePoints();
 
     unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
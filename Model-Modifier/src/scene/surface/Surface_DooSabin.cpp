@@ -15,9 +15,16 @@ Object Surface::DSOutputOBJ(
     std::vector<std::vector<unsigned int>> FaceIndices;
     std::unordered_map<unsigned int, unsigned int> NumberPolygons;
 
+    // at most one face per old face, edge and vertex
+    BeginStage("Emitting faces", static_cast<unsigned int>(m_Faces.size() + m_Edges.size() + m_Vertices.size()));
+
     // new face from old face (n-gon from n-gon)
     for (unsigned int currFaceIdx = 0; currFaceIdx < m_Faces.size(); currFaceIdx++)
     {
+        if (IsCancelled())
+            return Object();
+        ReportProgress(static_cast<unsigned int>(FaceIndices.size()));
+
         unsigned int n = static_cast<unsigned int>(newPointsPerFace[currFaceIdx].size());
 
         std::vector<unsigned int> newFaceIdx;
@@ -35,6 +42,10 @@ Object Surface::DSOutputOBJ(
     // new face from old edge (always a quad face)
     for (unsigned int currEdgeIdx = 0; currEdgeIdx < pointsPerEdge.size(); currEdgeIdx++)
     {
+        if (IsCancelled())
+            return Object();
+        ReportProgress(static_cast<unsigned int>(FaceIndices.size()));
+
         EdgeRecord currEdge = m_Edges[currEdgeIdx];
         // skip boundary edges, they cannot form a new face
         if (currEdge.adjFacesIdx.size() == 2)
@@ -75,6 +86,10 @@ Object Surface::DSOutputOBJ(
     // new face from old vertex (n-gon for n faces the old vertex neighbours)
     for (unsigned int currVertIdx = 0; currVertIdx < m_Vertices.size(); currVertIdx++)
     {
+        if (IsCancelled())
+            return Object();
+        ReportProgress(static_cast<unsigned int>(FaceIndices.size()));
+
         VertexRecord currVert = m_Vertices[currVertIdx];
         if (currVert.adjFacesIdx.size() < 3)
             continue;
@@ -140,7 +155,9 @@ Object Surface::DSOutputOBJ(
     Obj.m_Min = m_Min; Obj.m_Max = m_Max;
     Obj.m_VertexPos = VertexPos; Obj.m_FaceIndices = FaceIndices;
     Obj.m_NumPolygons = NumberPolygons;
-    Obj.TriangulateFaces();
+    Obj.TriangulateFaces(m_Progress);
+    if (IsCancelled())
+        return Object();
 
     return Obj;
 }
@@ -151,6 +168,9 @@ Object Surface::DSOutputOBJ(
 // Doo Sabin subdivision surface algorithm
 Object Surface::DooSabin()
 {
+    if (IsCancelled())
+        return Object();
+
     // make new vertices and store original vertex connectivity
     unsigned int numFaces =static_cast<unsigned int>(m_Faces.size());
     std::vector<std::vector<glm::vec3>> newPointsPerFace(numFaces);
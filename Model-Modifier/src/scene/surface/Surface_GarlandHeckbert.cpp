@@ -53,22 +53,79 @@ Object Surface::QEMOutputOBJ()
 
 ////////// helpers for the GH algorithm //////////
 
-// computer quadric matrix by summing all K_p matrices of a vertice v0
-glm::mat4 Surface::ComputePlaneQuadric(VertexRecord v0)
+// normal of every face, computed once instead of once per corner
+std::vector<glm::vec3> Surface::ComputeFaceNormals()
 {
-    glm::mat4 quadric{ 0.0f };
-    // for each neighbouring face, compute K_p
-    glm::vec3 position = v0.position;
-    for (unsigned int faceIdx : v0.adjFacesIdx)
-    {
-        FaceRecord face = m_Faces[faceIdx];
-        glm::vec3 faceNormal = ComputeFaceNormal(face);
-        glm::vec4 plane{ faceNormal, -glm::dot(faceNormal, position) }; // plane equation ax+by+cz+d = 0
+    std::vector<glm::vec3> faceNormals(m_Faces.size());
+    parallelFor(static_cast<unsigned int>(m_Faces.size()), [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                faceNormals[i] = ComputeFaceNormal(m_Faces[i]);
+            }
+        });
+    return faceNormals;
+}
 
-        quadric += glm::outerProduct(plane, plane); // K_p
-    }
+// compute the plane quadric of every vertex, with a penalty quadric added for boundary vertices
+std::vector<glm::mat4> Surface::ComputeVertexQuadrics()
+{
+    unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
+    unsigned int numEdges = static_cast<unsigned int>(m_Edges.size());
+    std::vector<glm::vec3> faceNormals = ComputeFaceNormals();
+
+    // penalty quadric of each boundary edge (edges with only one adjacent face)
+    std::vector<glm::mat4> boundaryQuadrics(numEdges, glm::mat4{ 0.0f });
+    std::vector<char> boundaryEdges(numEdges, false);
+    const float BOUNDARY_WEIGHT = 1000.0f; // large weight to preserve boundaries
+
+    parallelFor(numEdges, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                // Create constraint plane perpendicular to the boundary edge
+                const EdgeRecord& edge = m_Edges[i];
+                if (edge.adjFacesIdx.size() != 1 || edge.adjFacesIdx[0] >= m_Faces.size())
+                    continue;
 
-    return quadric;
+                glm::vec3 v1 = m_Vertices[edge.endPoint1Idx].position;
+                glm::vec3 v2 = m_Vertices[edge.endPoint2Idx].position;
+                glm::vec3 edgeDir = glm::normalize(v2 - v1);
+
+                // for a boundary edge, create a perpendicular constraint with face normal of the adjacent face
+                glm::vec3 perpendicular = glm::normalize(glm::cross(edgeDir, faceNormals[edge.adjFacesIdx[0]]));
+                glm::vec4 constraintPlane{ perpendicular, -glm::dot(perpendicular, v1) };
+                boundaryQuadrics[i] = BOUNDARY_WEIGHT * glm::outerProduct(constraintPlane, constraintPlane);
+                boundaryEdges[i] = true;
+            }
+        });
+
+    // gather per vertex, each thread only writes its own vertices
+    std::vector<glm::mat4> quadrics(numVertices);
+    parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                glm::mat4 quadric{ 0.0f };
+                glm::vec3 position = m_Vertices[i].position;
+                for (unsigned int faceIdx : m_Vertices[i].adjFacesIdx)
+                {
+                    glm::vec4 plane{ faceNormals[faceIdx], -glm::dot(faceNormals[faceIdx], position) };
+                    quadric += glm::outerProduct(plane, plane); // K_p
+                }
+
+                // add penalty quadric for boundary vertices
+                for (unsigned int edgeIdx : m_Vertices[i].adjEdgesIdx)
+                {
+                    if (boundaryEdges[edgeIdx])
+                        quadric += boundaryQuadrics[edgeIdx];
+                }
+
+                quadrics[i] = quadric;
+            }
+        });
+
+    return quadrics;
 }
 
 // build the matrix for solving optimal vertex position
@@ -126,6 +183,30 @@ void Surface::ComputeOptimalVertexAndError(ValidPair& validPair, const glm::mat4
     }
 }
 
+// half-edge collapse: keep whichever endpoint is cheaper, vertOne is swapped to be the kept vertex
+void Surface::ComputeHalfEdgeCollapseAndError(ValidPair& validPair, const glm::mat4& quadric1, const glm::mat4& quadric2)
+{
+    glm::mat4 Quad = quadric1 + quadric2;
+
+    glm::vec4 end1 = { m_Vertices[validPair.vertOne].position, 1.0f };
+    float end1Error = glm::dot(end1, Quad * end1);
+
+    glm::vec4 end2 = { m_Vertices[validPair.vertTwo].position, 1.0f };
+    float end2Error = glm::dot(end2, Quad * end2);
+
+    if (end2Error < end1Error)
+    {
+        std::swap(validPair.vertOne, validPair.vertTwo);
+        validPair.error = end2Error;
+        validPair.newVert = glm::vec3(end2);
+    }
+    else
+    {
+        validPair.error = end1Error;
+        validPair.newVert = glm::vec3(end1);
+    }
+}
+
 // update adjacency indices after face removal, removing deleted indices and shifting remaining ones
 void Surface::UpdateAdjacencyIndices(std::vector<unsigned int>& adjFaces, const std::vector<unsigned int>& removedFaceIndices)
 {
@@ -162,53 +243,61 @@ void Surface::UpdateAdjacencyIndices(std::vector<unsigned int>& adjFaces, const
 // Garland Heckbert simplification surface algorithm
 Object Surface::QEM(unsigned int desiredCount)
 {
-    unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
+    return QEM(std::vector<unsigned int>{ desiredCount })[0];
+}
+
+// no face budget, stops at the first collapse that would move the surface further than maxDistance
+Object Surface::QEMErrorBounded(float maxDistance)
+{
+    return QEM(std::vector<unsigned int>{ 0 }, maxDistance * maxDistance)[0];
+}
 
-    // identify boundary edges (edges with only one adjacent face)
-    std::set<unsigned int> boundaryEdges;
-    for (unsigned int i = 0; i < m_Edges.size(); i++)
+SnapshotTargets Surface::SortTargets(const std::vector<unsigned int>& desiredCounts)
+{
+    SnapshotTargets targets;
+    targets.counts = desiredCounts;
+    targets.order.resize(desiredCounts.size());
+    for (unsigned int i = 0; i < targets.order.size(); i++)
     {
-        if (m_Edges[i].adjFacesIdx.size() == 1)
-        {
-            boundaryEdges.insert(i);
-        }
+        targets.order[i] = i;
     }
+    std::stable_sort(targets.order.begin(), targets.order.end(), [&](unsigned int a, unsigned int b)
+        {
+            return desiredCounts[a] > desiredCounts[b];
+        });
+    targets.next = 0;
+    targets.snapshots.resize(desiredCounts.size());
 
-    // calculate quadric error for each vertex
-    std::unordered_map<unsigned int, glm::mat4> quadricLookup;
-    const float BOUNDARY_WEIGHT = 1000.0f; // large weight to preserve boundaries
+    m_SnapshotErrors.assign(desiredCounts.size(), 0.0f);
+    return targets;
+}
 
-    for (unsigned int i = 0; i < numVertices; i++)
+void Surface::SnapshotReachedTargets(SnapshotTargets& targets, unsigned int numFaces, bool finished)
+{
+    // targets reached together see the same mesh, it is compacted once and copied
+    unsigned int first = targets.next;
+    while (targets.next < targets.order.size() && (finished || numFaces <= targets.counts[targets.order[targets.next]]))
     {
-        glm::mat4 quadric = ComputePlaneQuadric(m_Vertices[i]);
-
-        // add penalty quadric for boundary vertices
-        bool isBoundaryVertex = false;
-        for (unsigned int edgeIdx : m_Vertices[i].adjEdgesIdx)
-        {
-            if (boundaryEdges.find(edgeIdx) != boundaryEdges.end())
-            {
-                isBoundaryVertex = true;
+        unsigned int target = targets.order[targets.next];
+        if (targets.next == first)
+            targets.snapshots[target] = QEMOutputOBJ();
+        else
+            targets.snapshots[target] = targets.snapshots[targets.order[first]];
+        m_SnapshotErrors[target] = m_SimplifyError;
+        targets.next++;
+    }
+}
 
-                // Create constraint plane perpendicular to the boundary edge
-                EdgeRecord& edge = m_Edges[edgeIdx];
-                glm::vec3 v1 = m_Vertices[edge.endPoint1Idx].position;
-                glm::vec3 v2 = m_Vertices[edge.endPoint2Idx].position;
-                glm::vec3 edgeDir = glm::normalize(v2 - v1);
+// several budgets share one run, collapses only ever go forward so each snapshot is taken on the way down
+std::vector<Object> Surface::QEM(const std::vector<unsigned int>& desiredCounts, float maxError)
+{
+    if (IsCancelled())
+        return std::vector<Object>(desiredCounts.size());
 
-                // for a boundary edge, create a perpendicular constraint with face normal of the adjacent face
-                if (!edge.adjFacesIdx.empty() && edge.adjFacesIdx[0] < m_Faces.size())
-                {
-                    glm::vec3 faceNormal = ComputeFaceNormal(m_Faces[edge.adjFacesIdx[0]]);
-                    glm::vec3 perpendicular = glm::normalize(glm::cross(edgeDir, faceNormal));
-                    glm::vec4 constraintPlane{ perpendicular, -glm::dot(perpendicular, v1) };
-                    quadric += BOUNDARY_WEIGHT * glm::outerProduct(constraintPlane, constraintPlane);
-                }
-            }
-        }
+    unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
 
-        quadricLookup.insert({ i, quadric });
-    }
+    // calculate quadric error for each vertex
+    std::vector<glm::mat4> quadricLookup = ComputeVertexQuadrics();
 
     const float THRESHOLD = 0.05f;
 
@@ -217,8 +306,13 @@ Object Surface::QEM(unsigned int desiredCount)
     vertexPairLookup.resize(numVertices);
 
     std::vector<ValidPair> validPairs;
+    BeginStage("Finding valid pairs", numVertices);
     for (unsigned int firstV = 0; firstV < numVertices; firstV++)
     {
+        if (IsCancelled())
+            return std::vector<Object>(desiredCounts.size());
+        ReportProgress(firstV);
+
         for (unsigned int secondV = firstV + 1; secondV < numVertices; secondV++)
         {
             auto searchx = m_EdgeIdxLookup.find(firstV);
@@ -262,7 +356,13 @@ Object Surface::QEM(unsigned int desiredCount)
     }
 
     // create a min-heap to store all the valid pairs, ordered by error cost
-    m_QuadricErrorHeap = std::priority_queue<ValidPair, std::vector<ValidPair>, CompareValidPairs>(validPairs.begin(), validPairs.end());
+    // every merge bumps the stamp of the kept vertex, entries pushed before it are stale
+    std::vector<unsigned int> stamps(numVertices, 0);
+    m_QuadricErrorHeap = std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, CompareCollapseCandidates>();
+    for (const ValidPair& validPair : validPairs)
+    {
+        m_QuadricErrorHeap.push({ validPair, 0, 0 });
+    }
 
     // track which pairs have been contracted to avoid processing stale duplicates
     std::set<std::pair<unsigned int, unsigned int>> contractedPairs;
@@ -270,12 +370,28 @@ Object Surface::QEM(unsigned int desiredCount)
     // track which vertices have been merged into others
     std::set<unsigned int> deletedVertices;
 
-    // iteratively remove the validpair with the lowest cost, until numFaces == desiredCount
+    SnapshotTargets targets = SortTargets(desiredCounts);
     unsigned int numFaces = static_cast<unsigned int>(m_Faces.size());
-    while (numFaces > desiredCount && !m_QuadricErrorHeap.empty())
+
+    // faces to remove before the smallest target, an error bound may stop the run earlier
+    unsigned int originalFaces = numFaces;
+    unsigned int smallestCount = targets.order.empty() ? 0 : desiredCounts[targets.order.back()];
+    BeginStage("Collapsing edges", originalFaces > smallestCount ? originalFaces - smallestCount : 0);
+
+    // iteratively remove the validpair with the lowest cost, until numFaces reaches the smallest desired count
+    while (!m_QuadricErrorHeap.empty())
     {
-        ValidPair leastCost = m_QuadricErrorHeap.top();
+        if (IsCancelled())
+            return std::vector<Object>(desiredCounts.size());
+        ReportProgress(originalFaces - numFaces);
+
+        SnapshotReachedTargets(targets, numFaces, false);
+        if (targets.next == targets.order.size())
+            break;
+
+        CollapseCandidate candidate = m_QuadricErrorHeap.top();
         m_QuadricErrorHeap.pop();
+        ValidPair leastCost = candidate.pair;
 
         // skip if either vertex has been deleted/merged
         if (deletedVertices.find(leastCost.vertOne) != deletedVertices.end() ||
@@ -284,6 +400,12 @@ Object Surface::QEM(unsigned int desiredCount)
             continue;
         }
 
+        // skip if a quadric changed since this entry was pushed, its error and position are outdated
+        if (stamps[leastCost.vertOne] != candidate.stampOne || stamps[leastCost.vertTwo] != candidate.stampTwo)
+        {
+            continue;
+        }
+
         // skip if this pair has already been contracted
         auto pairKey = std::make_pair(
             std::min(leastCost.vertOne, leastCost.vertTwo),
@@ -294,8 +416,13 @@ Object Surface::QEM(unsigned int desiredCount)
             continue;
         }
 
+        // every collapse left costs more than the error bound
+        if (leastCost.error > maxError)
+            break;
+
         // mark this pair as contracted
         contractedPairs.insert(pairKey);
+        m_SimplifyError = std::max(m_SimplifyError, leastCost.error);
 
         // mark vertTwo as deleted
         deletedVertices.insert(leastCost.vertTwo);
@@ -439,6 +566,7 @@ Object Surface::QEM(unsigned int desiredCount)
 
         // update the quadric for the merged vertex
         quadricLookup[leastCost.vertOne] = quadricLookup[leastCost.vertOne] + quadricLookup[leastCost.vertTwo];
+        stamps[leastCost.vertOne]++;
 
         // update the cost of all valid pairs involving the current pair
         for (unsigned int pairIdx : vertexPairLookup[leastCost.vertOne])
@@ -465,7 +593,7 @@ Object Surface::QEM(unsigned int desiredCount)
             if (deletedVertices.find(validPair.vertOne) == deletedVertices.end() &&
                 deletedVertices.find(validPair.vertTwo) == deletedVertices.end())
             {
-                m_QuadricErrorHeap.push(validPair);
+                m_QuadricErrorHeap.push({ validPair, stamps[validPair.vertOne], stamps[validPair.vertTwo] });
             }
         }
 
@@ -513,10 +641,11 @@ Object Surface::QEM(unsigned int desiredCount)
             if (deletedVertices.find(validPair.vertOne) == deletedVertices.end() &&
                 deletedVertices.find(validPair.vertTwo) == deletedVertices.end())
             {
-                m_QuadricErrorHeap.push(validPair);
+                m_QuadricErrorHeap.push({ validPair, stamps[validPair.vertOne], stamps[validPair.vertTwo] });
             }
         }
     }
+    SnapshotReachedTargets(targets, numFaces, true);
 
-    return QEMOutputOBJ();
+    return std::move(targets.snapshots);
 }
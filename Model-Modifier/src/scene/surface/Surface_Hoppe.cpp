@@ -0,0 +1,209 @@
+#include "Surface.h"
+
+
+////////// algorithms //////////
+
+// Hoppe progressive mesh: run QEM edge collapses all the way down and record every one of them,
+// so any face count can later be reached by replaying collapses or undoing them as vertex splits
+ProgressiveMesh Surface::BuildProgressiveMesh(bool halfEdge)
+{
+    if (IsCancelled())
+        return ProgressiveMesh();
+
+    unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
+
+    // triangles keep their original index for the whole recording
+    std::vector<glm::vec3> vertexPos(numVertices);
+    for (unsigned int i = 0; i < numVertices; i++)
+    {
+        vertexPos[i] = m_Vertices[i].position;
+    }
+
+    std::vector<glm::uvec3> faces;
+    std::vector<std::vector<unsigned int>> vertAdjFaces(numVertices);
+    std::vector<std::pair<unsigned int, unsigned int>> edges;
+    for (const FaceRecord& face : m_Faces)
+    {
+        // fan out faces that are not triangles
+        for (unsigned int j = 1; j + 1 < face.verticesIdx.size(); j++)
+        {
+            glm::uvec3 corners{ face.verticesIdx[0], face.verticesIdx[j], face.verticesIdx[j + 1] };
+            unsigned int faceIdx = static_cast<unsigned int>(faces.size());
+            faces.push_back(corners);
+
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                vertAdjFaces[corners[k]].push_back(faceIdx);
+                unsigned int start = corners[k];
+                unsigned int end = corners[(k + 1) % 3];
+                edges.push_back({ std::min(start, end), std::max(start, end) });
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    ProgressiveMesh progressiveMesh(vertexPos, faces, m_Min, m_Max);
+
+    std::vector<glm::mat4> quadrics = ComputeVertexQuadrics();
+    std::vector<unsigned int> stamps(numVertices, 0);
+    std::vector<bool> deletedVertices(numVertices, false);
+    std::vector<bool> faceAlive(faces.size(), true);
+
+    std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, CompareCollapseCandidates> collapseHeap;
+    auto pushCandidate = [&](unsigned int keep, unsigned int remove)
+    {
+        CollapseCandidate candidate{};
+        candidate.pair.vertOne = keep; candidate.pair.vertTwo = remove; candidate.pair.edge = true;
+        if (halfEdge)
+            ComputeHalfEdgeCollapseAndError(candidate.pair, quadrics[keep], quadrics[remove]);
+        else
+            ComputeOptimalVertexAndError(candidate.pair, quadrics[keep], quadrics[remove]);
+        candidate.stampOne = stamps[candidate.pair.vertOne]; candidate.stampTwo = stamps[candidate.pair.vertTwo];
+        collapseHeap.push(candidate);
+    };
+
+    // only edges are valid pairs here, a vertex split can only undo an edge collapse
+    for (std::pair<unsigned int, unsigned int> edge : edges)
+    {
+        pushCandidate(edge.first, edge.second);
+    }
+
+    // collapse until nothing is left, recording every step
+    unsigned int numFaces = static_cast<unsigned int>(faces.size());
+    BeginStage("Recording collapses", numFaces);
+    while (!collapseHeap.empty())
+    {
+        if (IsCancelled())
+            return ProgressiveMesh();
+        ReportProgress(static_cast<unsigned int>(faces.size()) - numFaces);
+
+        CollapseCandidate leastCost = collapseHeap.top();
+        collapseHeap.pop();
+
+        unsigned int vertOne = leastCost.pair.vertOne;
+        unsigned int vertTwo = leastCost.pair.vertTwo;
+
+        // skip if either vertex was merged away, or its quadric changed since this entry was pushed
+        if (deletedVertices[vertOne] || deletedVertices[vertTwo] ||
+            stamps[vertOne] != leastCost.stampOne || stamps[vertTwo] != leastCost.stampTwo)
+        {
+            continue;
+        }
+
+        VertexSplitRecord record;
+        record.vertKept = vertOne;
+        record.vertRemoved = vertTwo;
+        record.keptPosition = m_Vertices[vertOne].position;
+        record.newPosition = leastCost.pair.newVert;
+        record.error = leastCost.pair.error;
+
+        // faces around both endpoints, with their corners after the collapse and normals before it
+        std::vector<unsigned int> facesToUpdate;
+        std::vector<glm::uvec3> updatedCorners;
+        std::vector<glm::vec3> originalNormals;
+
+        for (unsigned int faceIdx : vertAdjFaces[vertTwo])
+        {
+            if (!faceAlive[faceIdx])
+                continue;
+
+            glm::uvec3 corners = faces[faceIdx];
+            if (corners[0] == vertOne || corners[1] == vertOne || corners[2] == vertOne)
+            {
+                // the face contains both vertices, it becomes degenerate
+                faceAlive[faceIdx] = false;
+                record.removedFaces.push_back(faceIdx);
+                numFaces--;
+                continue;
+            }
+
+            originalNormals.push_back(glm::cross(
+                vertexPos[corners[1]] - vertexPos[corners[0]],
+                vertexPos[corners[2]] - vertexPos[corners[0]]
+            ));
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                if (corners[k] == vertTwo)
+                    corners[k] = vertOne;
+            }
+            facesToUpdate.push_back(faceIdx);
+            updatedCorners.push_back(corners);
+        }
+
+        for (unsigned int faceIdx : vertAdjFaces[vertOne])
+        {
+            if (!faceAlive[faceIdx])
+                continue;
+
+            glm::uvec3 corners = faces[faceIdx];
+            originalNormals.push_back(glm::cross(
+                vertexPos[corners[1]] - vertexPos[corners[0]],
+                vertexPos[corners[2]] - vertexPos[corners[0]]
+            ));
+            facesToUpdate.push_back(faceIdx);
+            updatedCorners.push_back(corners);
+        }
+
+        // contract the pair
+        vertexPos[vertOne] = leastCost.pair.newVert;
+        m_Vertices[vertOne].position = leastCost.pair.newVert;
+
+        for (unsigned int i = 0; i < facesToUpdate.size(); i++)
+        {
+            glm::uvec3& corners = updatedCorners[i];
+            glm::vec3 newNormal = glm::cross(
+                vertexPos[corners[1]] - vertexPos[corners[0]],
+                vertexPos[corners[2]] - vertexPos[corners[0]]
+            );
+
+            // if new normal is opposite to original, flip the face to preserve orientation
+            float originalLength = glm::length(originalNormals[i]);
+            float newLength = glm::length(newNormal);
+            if (originalLength > 1e-6f && newLength > 1e-6f &&
+                glm::dot(newNormal / newLength, originalNormals[i] / originalLength) < 0.0f)
+            {
+                std::swap(corners[0], corners[2]);
+            }
+
+            unsigned int faceIdx = facesToUpdate[i];
+            if (corners != faces[faceIdx])
+            {
+                record.changedFaces.push_back(faceIdx);
+                record.oldCorners.push_back(faces[faceIdx]);
+                record.newCorners.push_back(corners);
+                faces[faceIdx] = corners;
+            }
+        }
+
+        // vertOne inherits the faces and quadric of vertTwo
+        vertAdjFaces[vertOne] = facesToUpdate;
+        std::vector<unsigned int>().swap(vertAdjFaces[vertTwo]);
+        quadrics[vertOne] = quadrics[vertOne] + quadrics[vertTwo];
+        deletedVertices[vertTwo] = true;
+        stamps[vertOne]++;
+
+        record.numFaces = numFaces;
+        progressiveMesh.AddRecord(record);
+
+        // re-evaluate every edge around the merged vertex
+        std::vector<unsigned int> neighbours;
+        for (unsigned int faceIdx : facesToUpdate)
+        {
+            for (unsigned int k = 0; k < 3; k++)
+            {
+                if (faces[faceIdx][k] != vertOne)
+                    neighbours.push_back(faces[faceIdx][k]);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+        for (unsigned int neighbour : neighbours)
+        {
+            pushCandidate(vertOne, neighbour);
+        }
+    }
+
+    return progressiveMesh;
+}
@@ -1,75 +1,11 @@
 #include "Surface.h"
 
+#include <cstring>
 
-////////// helpers for the LRZ algorithm //////////
-
-// compute line quadric by constructing quadric matrices from edges adjacent to vertex
-// note this is not the same as the paper, we sum over adjacent edges instead of using vertex normal
-// the proper implementation is below
-glm::mat4 Surface::ComputeLineQuadric(VertexRecord v0)
-{
-    glm::mat4 lineQuadric{ 0.0f };
-    glm::vec3 position = v0.position;
-
-    // for each adjacent edge, create a line constraint
-    for (unsigned int edgeIdx : v0.adjEdgesIdx)
-    {
-        if (edgeIdx >= m_Edges.size()) continue;
-
-        EdgeRecord edge = m_Edges[edgeIdx];
-
-        // get the other endpoint of the edge
-        glm::vec3 otherPos;
-        if (edge.endPoint1Idx < m_Vertices.size() && edge.endPoint2Idx < m_Vertices.size())
-        {
-            if (m_Vertices[edge.endPoint1Idx].position == position)
-            {
-                otherPos = m_Vertices[edge.endPoint2Idx].position;
-            }
-            else
-            {
-                otherPos = m_Vertices[edge.endPoint1Idx].position;
-            }
-        }
-        else
-        {
-            continue;
-        }
-
-        // compute line direction
-        glm::vec3 lineDir = glm::normalize(otherPos - position);
-
-        // create perpendicular constraint planes for the line
-        // we need two orthogonal planes that contain the line
-        glm::vec3 perp1, perp2;
-
-        // find first perpendicular vector
-        if (std::abs(lineDir.x) < 0.9f)
-        {
-            perp1 = glm::normalize(glm::cross(lineDir, glm::vec3(1.0f, 0.0f, 0.0f)));
-        }
-        else
-        {
-            perp1 = glm::normalize(glm::cross(lineDir, glm::vec3(0.0f, 1.0f, 0.0f)));
-        }
 
-        // second perpendicular is orthogonal to both line and first perpendicular
-        perp2 = glm::normalize(glm::cross(lineDir, perp1));
-
-        // create plane equations: the point should lie on the line
-        // perpendicular constraint: n · (x - p) = 0 → n · x = n · p
-        glm::vec4 plane1{ perp1, -glm::dot(perp1, position) };
-        glm::vec4 plane2{ perp2, -glm::dot(perp2, position) };
-
-        // add both perpendicular plane quadrics
-        lineQuadric += glm::outerProduct(plane1, plane1);
-        lineQuadric += glm::outerProduct(plane2, plane2);
-    }
-
-    return lineQuadric;
-}
+////////// helpers for the LRZ algorithm //////////
 
-// proper implementation of line quadric
+// proper implementation of a per vertex line quadric, from the vertex normal
 // glm::mat4 Surface::ComputeLineQuadric(VertexRecord v0)
 // {
 //     glm::mat4 lineQuadric{ 0.0f };
@@ -112,59 +48,144 @@ glm::mat4 Surface::ComputeWeightedQuadric(const glm::mat4& planeQuadric, const g
     return planeQuadric + alpha * lineQuadric;
 }
 
-
-////////// algorithms //////////
-
-// Liu Rahimzadeh Zordan QEM simplification with line quadric constraints
-Object Surface::LineQEM(unsigned int desiredCount, float alpha)
+// line quadric of every vertex, from two planes containing each adjacent edge, built once per edge
+// note this is not the same as the paper, we sum over adjacent edges instead of using vertex normal
+std::vector<glm::mat4> Surface::ComputeLineQuadrics()
 {
     unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
+    unsigned int numEdges = static_cast<unsigned int>(m_Edges.size());
 
-    // identify boundary edges (edges with only one adjacent face)
-    std::set<unsigned int> boundaryEdges;
-    for (unsigned int i = 0; i < m_Edges.size(); i++)
-    {
-        if (m_Edges[i].adjFacesIdx.size() == 1)
+    // perpendiculars of each edge, reversing the edge only flips the first one which leaves its quadric unchanged
+    std::vector<glm::vec3> edgePerps(2 * numEdges);
+    parallelFor(numEdges, [&](unsigned int begin, unsigned int end)
         {
-            boundaryEdges.insert(i);
-        }
-    }
+            for (unsigned int i = begin; i < end; i++)
+            {
+                const EdgeRecord& edge = m_Edges[i];
+                if (edge.endPoint1Idx >= numVertices || edge.endPoint2Idx >= numVertices)
+                    continue;
 
-    // calculate both point and line quadrics for each vertex
-    std::unordered_map<unsigned int, glm::mat4> planeQuadricLookup;
-    std::unordered_map<unsigned int, glm::mat4> lineQuadricLookup;
-    const float BOUNDARY_WEIGHT = 1000.0f; // large weight to preserve boundaries
+                glm::vec3 lineDir = glm::normalize(m_Vertices[edge.endPoint2Idx].position - m_Vertices[edge.endPoint1Idx].position);
 
-    for (unsigned int i = 0; i < numVertices; i++)
-    {
-        glm::mat4 planeQuadric = ComputePlaneQuadric(m_Vertices[i]);
-        glm::mat4 lineQuadric = ComputeLineQuadric(m_Vertices[i]);
+                // find first perpendicular vector
+                glm::vec3 perp1;
+                if (std::abs(lineDir.x) < 0.9f)
+                {
+                    perp1 = glm::normalize(glm::cross(lineDir, glm::vec3(1.0f, 0.0f, 0.0f)));
+                }
+                else
+                {
+                    perp1 = glm::normalize(glm::cross(lineDir, glm::vec3(0.0f, 1.0f, 0.0f)));
+                }
+
+                edgePerps[2 * i + 0] = perp1;
+                edgePerps[2 * i + 1] = glm::normalize(glm::cross(lineDir, perp1));
+            }
+        });
 
-        // add penalty quadric for boundary vertices to point quadric
-        for (unsigned int edgeIdx : m_Vertices[i].adjEdgesIdx)
+    // gather per vertex, every face sharing an edge adds its constraint again
+    std::vector<glm::mat4> lineQuadrics(numVertices);
+    parallelFor(numVertices, [&](unsigned int begin, unsigned int end)
         {
-            if (boundaryEdges.find(edgeIdx) != boundaryEdges.end())
+            for (unsigned int i = begin; i < end; i++)
             {
-                // Create constraint plane perpendicular to the boundary edge
-                EdgeRecord& edge = m_Edges[edgeIdx];
-                glm::vec3 v1 = m_Vertices[edge.endPoint1Idx].position;
-                glm::vec3 v2 = m_Vertices[edge.endPoint2Idx].position;
-                glm::vec3 edgeDir = glm::normalize(v2 - v1);
-
-                // for a boundary edge, create a perpendicular constraint with face normal of the adjacent face
-                if (!edge.adjFacesIdx.empty() && edge.adjFacesIdx[0] < m_Faces.size())
+                glm::mat4 lineQuadric{ 0.0f };
+                glm::vec3 position = m_Vertices[i].position;
+                for (unsigned int edgeIdx : m_Vertices[i].adjEdgesIdx)
                 {
-                    glm::vec3 faceNormal = ComputeFaceNormal(m_Faces[edge.adjFacesIdx[0]]);
-                    glm::vec3 perpendicular = glm::normalize(glm::cross(edgeDir, faceNormal));
-                    glm::vec4 constraintPlane{ perpendicular, -glm::dot(perpendicular, v1) };
-                    planeQuadric += BOUNDARY_WEIGHT * glm::outerProduct(constraintPlane, constraintPlane);
+                    if (edgeIdx >= numEdges || m_Edges[edgeIdx].endPoint1Idx >= numVertices || m_Edges[edgeIdx].endPoint2Idx >= numVertices)
+                        continue;
+
+                    glm::vec4 plane1{ edgePerps[2 * edgeIdx + 0], -glm::dot(edgePerps[2 * edgeIdx + 0], position) };
+                    glm::vec4 plane2{ edgePerps[2 * edgeIdx + 1], -glm::dot(edgePerps[2 * edgeIdx + 1], position) };
+                    lineQuadric += glm::outerProduct(plane1, plane1);
+                    lineQuadric += glm::outerProduct(plane2, plane2);
                 }
+                lineQuadrics[i] = lineQuadric;
             }
+        });
+
+    return lineQuadrics;
+}
+
+void Surface::PrecomputeQuadrics(QuadricCache& cache)
+{
+    // hashing is linear, far cheaper than the quadrics it saves
+    unsigned long long key = ComputeGeometryKey();
+    if (cache.geometryKey == key && cache.planeQuadrics.size() == m_Vertices.size() && cache.lineQuadrics.size() == m_Vertices.size())
+        return;
+
+    cache.planeQuadrics = ComputeVertexQuadrics();
+    cache.lineQuadrics = ComputeLineQuadrics();
+    cache.geometryKey = key;
+}
+
+unsigned long long Surface::ComputeGeometryKey() const
+{
+    // FNV-1a over the position bits and the face corners
+    unsigned long long key = 14695981039346656037ull;
+    auto hashWord = [&key](unsigned int word)
+    {
+        for (unsigned int byte = 0; byte < 4; byte++)
+        {
+            key ^= (word >> (8 * byte)) & 0xFF;
+            key *= 1099511628211ull;
+        }
+    };
+
+    for (const VertexRecord& vertex : m_Vertices)
+    {
+        for (unsigned int coord = 0; coord < 3; coord++)
+        {
+            unsigned int bits;
+            std::memcpy(&bits, &vertex.position[coord], sizeof(bits));
+            hashWord(bits);
         }
+    }
+    for (const FaceRecord& face : m_Faces)
+    {
+        hashWord(static_cast<unsigned int>(face.verticesIdx.size()));
+        for (unsigned int vertIdx : face.verticesIdx)
+        {
+            hashWord(vertIdx);
+        }
+    }
+    return key;
+}
 
-        planeQuadricLookup.insert({ i, planeQuadric });
-        lineQuadricLookup.insert({ i, lineQuadric });
+std::vector<glm::mat4> Surface::ComputeWeightedQuadrics(const QuadricCache& cache, float alpha)
+{
+    std::vector<glm::mat4> weightedQuadrics(m_Vertices.size());
+    for (unsigned int i = 0; i < m_Vertices.size(); i++)
+    {
+        weightedQuadrics[i] = ComputeWeightedQuadric(cache.planeQuadrics[i], cache.lineQuadrics[i], alpha);
     }
+    return weightedQuadrics;
+}
+
+
+////////// algorithms //////////
+
+// Liu Rahimzadeh Zordan QEM simplification with line quadric constraints
+Object Surface::LineQEM(unsigned int desiredCount, float alpha, QuadricCache* cache)
+{
+    return LineQEM(std::vector<unsigned int>{ desiredCount }, alpha, std::numeric_limits<float>::max(), cache)[0];
+}
+
+// multi-target variant, snapshots are taken from the largest budget to the smallest in a single run
+std::vector<Object> Surface::LineQEM(const std::vector<unsigned int>& desiredCounts, float alpha, float maxError, QuadricCache* cache)
+{
+    if (IsCancelled())
+        return std::vector<Object>(desiredCounts.size());
+
+    unsigned int numVertices = static_cast<unsigned int>(m_Vertices.size());
+
+    // plane (with boundary penalty) plus alpha weighted line quadric of each vertex, merged by summing
+    // the cache holds the quadrics of the unmodified surface, the run only reads it
+    QuadricCache localQuadrics;
+    QuadricCache& quadrics = cache ? *cache : localQuadrics;
+    PrecomputeQuadrics(quadrics);
+    std::vector<glm::mat4> quadricLookup = ComputeWeightedQuadrics(quadrics, alpha);
 
     const float THRESHOLD = 0.05f;
 
@@ -173,8 +194,13 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
     vertexPairLookup.resize(numVertices);
 
     std::vector<ValidPair> validPairs;
+    BeginStage("Finding valid pairs", numVertices);
     for (unsigned int firstV = 0; firstV < numVertices; firstV++)
     {
+        if (IsCancelled())
+            return std::vector<Object>(desiredCounts.size());
+        ReportProgress(firstV);
+
         for (unsigned int secondV = firstV + 1; secondV < numVertices; secondV++)
         {
             auto searchx = m_EdgeIdxLookup.find(firstV);
@@ -219,15 +245,17 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
     // compute the new point and error associated for each valid pair
     for (ValidPair& validPair : validPairs)
     {
-        ComputeOptimalVertexAndError(
-            validPair,
-            ComputeWeightedQuadric(planeQuadricLookup[validPair.vertOne], lineQuadricLookup[validPair.vertOne], alpha),
-            ComputeWeightedQuadric(planeQuadricLookup[validPair.vertTwo], lineQuadricLookup[validPair.vertTwo], alpha)
-        );
+        ComputeOptimalVertexAndError(validPair, quadricLookup[validPair.vertOne], quadricLookup[validPair.vertTwo]);
     }
 
     // create a min-heap to store all the valid pairs, ordered by error cost
-    m_QuadricErrorHeap = std::priority_queue<ValidPair, std::vector<ValidPair>, CompareValidPairs>(validPairs.begin(), validPairs.end());
+    // every merge bumps the stamp of the kept vertex, entries pushed before it are stale
+    std::vector<unsigned int> stamps(numVertices, 0);
+    m_QuadricErrorHeap = std::priority_queue<CollapseCandidate, std::vector<CollapseCandidate>, CompareCollapseCandidates>();
+    for (const ValidPair& validPair : validPairs)
+    {
+        m_QuadricErrorHeap.push({ validPair, 0, 0 });
+    }
 
     // track which pairs have been contracted to avoid processing stale duplicates
     std::set<std::pair<unsigned int, unsigned int>> contractedPairs;
@@ -235,12 +263,28 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
     // track which vertices have been merged into others
     std::set<unsigned int> deletedVertices;
 
-    // iteratively remove the validpair with the lowest cost, until numFaces == desiredCount
+    SnapshotTargets targets = SortTargets(desiredCounts);
     unsigned int numFaces = static_cast<unsigned int>(m_Faces.size());
-    while (numFaces > desiredCount && !m_QuadricErrorHeap.empty())
+
+    // faces to remove before the smallest target, an error bound may stop the run earlier
+    unsigned int originalFaces = numFaces;
+    unsigned int smallestCount = targets.order.empty() ? 0 : desiredCounts[targets.order.back()];
+    BeginStage("Collapsing edges", originalFaces > smallestCount ? originalFaces - smallestCount : 0);
+
+    // iteratively remove the validpair with the lowest cost, until numFaces reaches the smallest desired count
+    while (!m_QuadricErrorHeap.empty())
     {
-        ValidPair leastCost = m_QuadricErrorHeap.top();
+        if (IsCancelled())
+            return std::vector<Object>(desiredCounts.size());
+        ReportProgress(originalFaces - numFaces);
+
+        SnapshotReachedTargets(targets, numFaces, false);
+        if (targets.next == targets.order.size())
+            break;
+
+        CollapseCandidate candidate = m_QuadricErrorHeap.top();
         m_QuadricErrorHeap.pop();
+        ValidPair leastCost = candidate.pair;
 
         // skip if either vertex has been deleted/merged
         if (deletedVertices.find(leastCost.vertOne) != deletedVertices.end() ||
@@ -249,6 +293,12 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
             continue;
         }
 
+        // skip if a quadric changed since this entry was pushed, its error and position are outdated
+        if (stamps[leastCost.vertOne] != candidate.stampOne || stamps[leastCost.vertTwo] != candidate.stampTwo)
+        {
+            continue;
+        }
+
         // skip if this pair has already been contracted
         auto pairKey = std::make_pair(
             std::min(leastCost.vertOne, leastCost.vertTwo),
@@ -259,8 +309,13 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
             continue;
         }
 
+        // every collapse left costs more than the error bound
+        if (leastCost.error > maxError)
+            break;
+
         // mark this pair as contracted
         contractedPairs.insert(pairKey);
+        m_SimplifyError = std::max(m_SimplifyError, leastCost.error);
 
         // mark vertTwo as deleted
         deletedVertices.insert(leastCost.vertTwo);
@@ -400,9 +455,9 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
 
         numFaces = static_cast<unsigned int>(m_Faces.size());
 
-        // update both point and line quadrics for the merged vertex
-        planeQuadricLookup[leastCost.vertOne] = planeQuadricLookup[leastCost.vertOne] + planeQuadricLookup[leastCost.vertTwo];
-        lineQuadricLookup[leastCost.vertOne] = lineQuadricLookup[leastCost.vertOne] + lineQuadricLookup[leastCost.vertTwo];
+        // update the weighted quadric for the merged vertex, the weighting is linear so the sums commute
+        quadricLookup[leastCost.vertOne] = quadricLookup[leastCost.vertOne] + quadricLookup[leastCost.vertTwo];
+        stamps[leastCost.vertOne]++;
 
         // update the cost of all valid pairs involving the current pair
         for (unsigned int pairIdx : vertexPairLookup[leastCost.vertOne])
@@ -423,17 +478,13 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
             unsigned int otherVert = (validPair.vertOne == leastCost.vertOne) ? validPair.vertTwo : validPair.vertOne;
 
             // recalculate error for this pair
-            ComputeOptimalVertexAndError(
-                validPair,
-                ComputeWeightedQuadric(planeQuadricLookup[leastCost.vertOne], lineQuadricLookup[leastCost.vertOne], alpha),
-                ComputeWeightedQuadric(planeQuadricLookup[otherVert], lineQuadricLookup[otherVert], alpha)
-            );
+            ComputeOptimalVertexAndError(validPair, quadricLookup[leastCost.vertOne], quadricLookup[otherVert]);
 
             // push back to heap if neither vertex has been deleted
             if (deletedVertices.find(validPair.vertOne) == deletedVertices.end() &&
                 deletedVertices.find(validPair.vertTwo) == deletedVertices.end())
             {
-                m_QuadricErrorHeap.push(validPair);
+                m_QuadricErrorHeap.push({ validPair, stamps[validPair.vertOne], stamps[validPair.vertTwo] });
             }
         }
 
@@ -475,20 +526,17 @@ Object Surface::LineQEM(unsigned int desiredCount, float alpha)
             vertexPairLookup[leastCost.vertOne].insert(pairIdx);
 
             // recalculate error for this pair
-            ComputeOptimalVertexAndError(
-                validPair,
-                ComputeWeightedQuadric(planeQuadricLookup[leastCost.vertOne], lineQuadricLookup[leastCost.vertOne], alpha),
-                ComputeWeightedQuadric(planeQuadricLookup[otherVert], lineQuadricLookup[otherVert], alpha)
-            );
+            ComputeOptimalVertexAndError(validPair, quadricLookup[leastCost.vertOne], quadricLookup[otherVert]);
 
             // push back to heap if neither vertex has been deleted
             if (deletedVertices.find(validPair.vertOne) == deletedVertices.end() &&
                 deletedVertices.find(validPair.vertTwo) == deletedVertices.end())
             {
-                m_QuadricErrorHeap.push(validPair);
+                m_QuadricErrorHeap.push({ validPair, stamps[validPair.vertOne], stamps[validPair.vertTwo] });
             }
         }
     }
+    SnapshotReachedTargets(targets, numFaces, true);
 
-    return QEMOutputOBJ();
+    return std::move(targets.snapshots);
 }
@@ -11,8 +11,20 @@ Object Surface::LoOutputOBJ(std::vector<glm::vec3> edgePoints)
     std::vector<std::vector<unsigned int>> FaceIndices;
     std::unordered_map<unsigned int, unsigned int> NumberPolygons;
 
+    // every n-gon becomes n + 1 faces
+    unsigned int expectedFaces = 0;
+    for (const FaceRecord& face : m_Faces)
+    {
+        expectedFaces += static_cast<unsigned int>(face.verticesIdx.size()) + 1;
+    }
+    BeginStage("Emitting faces", expectedFaces);
+
     for (FaceRecord face : m_Faces)
     {
+        if (IsCancelled())
+            return Object();
+        ReportProgress(static_cast<unsigned int>(FaceIndices.size()));
+
         unsigned int n = static_cast<unsigned int>(face.verticesIdx.size());
 
         std::vector<unsigned int> vertsIdx;
@@ -42,7 +54,9 @@ Object Surface::LoOutputOBJ(std::vector<glm::vec3> edgePoints)
     Obj.m_Min = m_Min; Obj.m_Max = m_Max;
     Obj.m_VertexPos = VertexPos; Obj.m_FaceIndices = FaceIndices;
     Obj.m_NumPolygons = NumberPolygons;
-    Obj.TriangulateFaces();
+    Obj.TriangulateFaces(m_Progress);
+    if (IsCancelled())
+        return Object();
 
     return Obj;
 }
@@ -53,6 +67,9 @@ Object Surface::LoOutputOBJ(std::vector<glm::vec3> edgePoints)
 // Loop subdivision surface algorithm
 Object Surface::Loop()
 {
+    if (IsCancelled())
+        return Object();
+
     unsigned int numEdges = static_cast<unsigned int>(m_Edges.size());
     // make new (odd) vertices (per edge)
     std::vector<glm::vec3> edgePoints(numEdges);
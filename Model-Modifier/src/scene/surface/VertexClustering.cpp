@@ -0,0 +1,253 @@
+#include "VertexClustering.h"
+
+#include <algorithm>
+#include <cmath>
+
+// solve for the point minimizing the cell quadric, returns false when the quadric is (near) singular
+static bool SolveClusterQuadric(const double q[10], glm::dvec3& solution)
+{
+    // A = | q0 q1 q2 |   b = | q3 |
+    //     | q1 q4 q5 |       | q6 |
+    //     | q2 q5 q7 |       | q8 |
+    double det = q[0] * (q[4] * q[7] - q[5] * q[5])
+               - q[1] * (q[1] * q[7] - q[5] * q[2])
+               + q[2] * (q[1] * q[5] - q[4] * q[2]);
+
+    double trace = (q[0] + q[4] + q[7]) / 3.0;
+    if (trace <= 0.0 || std::abs(det) < 1e-6 * trace * trace * trace)
+        return false;
+
+    // Cramer's rule on A x = -b
+    glm::dvec3 rhs{ -q[3], -q[6], -q[8] };
+    double detX = rhs.x * (q[4] * q[7] - q[5] * q[5])
+                - q[1] * (rhs.y * q[7] - q[5] * rhs.z)
+                + q[2] * (rhs.y * q[5] - q[4] * rhs.z);
+    double detY = q[0] * (rhs.y * q[7] - q[5] * rhs.z)
+                - rhs.x * (q[1] * q[7] - q[5] * q[2])
+                + q[2] * (q[1] * rhs.z - rhs.y * q[2]);
+    double detZ = q[0] * (q[4] * rhs.z - rhs.y * q[5])
+                - q[1] * (q[1] * rhs.z - rhs.y * q[2])
+                + rhs.x * (q[1] * q[5] - q[4] * q[2]);
+
+    solution = glm::dvec3{ detX, detY, detZ } / det;
+    return true;
+}
+
+// report every few thousand items, the passes are too short per item to touch the atomics each time
+// returns true once cancelled
+static bool UpdateProgress(Progress* progress, unsigned int done)
+{
+    if (!progress || (done & 0xFFF) != 0)
+        return false;
+    progress->Report(done);
+    return progress->IsCancelled();
+}
+
+Object VertexClustering(const Object& obj, unsigned int gridResolution, Progress* progress)
+{
+    if (progress && progress->IsCancelled())
+        return Object();
+
+    gridResolution = std::max(gridResolution, 1u);
+
+    // bounding box of the vertices (m_Min/m_Max are the bounds before rescaling)
+    glm::vec3 boxMin{ 1e30f };
+    glm::vec3 boxMax{ -1e30f };
+    for (glm::vec3 vertPos : obj.m_VertexPos)
+    {
+        boxMin = glm::min(boxMin, vertPos);
+        boxMax = glm::max(boxMax, vertPos);
+    }
+    glm::vec3 extent = boxMax - boxMin;
+    float longest = std::max({ extent.x, extent.y, extent.z, 1e-12f });
+    float cellSize = longest / gridResolution;
+
+    glm::uvec3 gridDims;
+    for (unsigned int coord = 0; coord < 3; coord++)
+    {
+        gridDims[coord] = std::max(1u, static_cast<unsigned int>(std::ceil(extent[coord] / cellSize)));
+    }
+
+    // cell of every vertex, flattened as x + y * nx + z * nx * ny, then mapped to a dense cell index
+    const unsigned int UNUSED = 0xFFFFFFFF;
+    std::unordered_map<unsigned long long, unsigned int> cellLookup;
+    std::vector<unsigned long long> cellKeys;
+    std::vector<unsigned int> vertCell(obj.m_VertexPos.size());
+    if (progress)
+        progress->BeginStage("Assigning vertices to cells", static_cast<unsigned int>(obj.m_VertexPos.size()));
+    for (unsigned int i = 0; i < obj.m_VertexPos.size(); i++)
+    {
+        if (UpdateProgress(progress, i))
+            return Object();
+
+        glm::vec3 gridPos = (obj.m_VertexPos[i] - boxMin) / cellSize;
+        unsigned long long cellCoord[3];
+        for (unsigned int coord = 0; coord < 3; coord++)
+        {
+            cellCoord[coord] = std::min(static_cast<unsigned long long>(std::max(gridPos[coord], 0.0f)), static_cast<unsigned long long>(gridDims[coord] - 1));
+        }
+        unsigned long long key = cellCoord[0] + gridDims.x * (cellCoord[1] + static_cast<unsigned long long>(gridDims.y) * cellCoord[2]);
+
+        auto search = cellLookup.find(key);
+        if (search == cellLookup.end())
+        {
+            search = cellLookup.insert({ key, static_cast<unsigned int>(cellKeys.size()) }).first;
+            cellKeys.push_back(key);
+        }
+        vertCell[i] = search->second;
+    }
+    std::unordered_map<unsigned long long, unsigned int>().swap(cellLookup);
+
+    std::vector<ClusterCell> cells(cellKeys.size(), ClusterCell{});
+    for (ClusterCell& cell : cells)
+    {
+        cell.outIdx = UNUSED;
+    }
+
+    // single streaming pass over the triangles, accumulating area weighted plane quadrics per cell
+    unsigned int numFaces = static_cast<unsigned int>(obj.m_TriFaceIndices.size());
+    if (progress)
+        progress->BeginStage("Accumulating cell quadrics", numFaces);
+    for (unsigned int i = 0; i < numFaces; i++)
+    {
+        if (UpdateProgress(progress, i))
+            return Object();
+
+        const std::vector<unsigned int>& face = obj.m_TriFaceIndices[i];
+        glm::dvec3 p0 = obj.m_VertexPos[face[0]];
+        glm::dvec3 p1 = obj.m_VertexPos[face[1]];
+        glm::dvec3 p2 = obj.m_VertexPos[face[2]];
+        glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        double doubleArea = glm::length(normal);
+
+        double plane[4] = { 0.0, 0.0, 0.0, 0.0 };
+        if (doubleArea > 0.0)
+        {
+            normal /= doubleArea;
+            plane[0] = normal.x; plane[1] = normal.y; plane[2] = normal.z;
+            plane[3] = -glm::dot(normal, p0);
+        }
+        double weight = 0.5 * doubleArea;
+
+        for (unsigned int corner = 0; corner < 3; corner++)
+        {
+            ClusterCell& cell = cells[vertCell[face[corner]]];
+
+            unsigned int k = 0;
+            for (unsigned int row = 0; row < 4; row++)
+            {
+                for (unsigned int col = row; col < 4; col++)
+                {
+                    cell.quadric[k++] += weight * plane[row] * plane[col];
+                }
+            }
+            cell.positionSum += glm::dvec3(obj.m_VertexPos[face[corner]]);
+            cell.numVertices++;
+        }
+    }
+
+    // keep triangles spanning three different cells, each cell becomes one vertex
+    std::vector<glm::vec3> VertexPos;
+    std::vector<glm::uvec3> triangles;
+    if (progress)
+        progress->BeginStage("Emitting triangles", numFaces);
+    for (unsigned int i = 0; i < numFaces; i++)
+    {
+        if (UpdateProgress(progress, i))
+            return Object();
+
+        const std::vector<unsigned int>& face = obj.m_TriFaceIndices[i];
+        unsigned int corners[3] = { vertCell[face[0]], vertCell[face[1]], vertCell[face[2]] };
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0])
+            continue; // degenerate after clustering
+
+        glm::uvec3 triangle;
+        for (unsigned int corner = 0; corner < 3; corner++)
+        {
+            ClusterCell& cell = cells[corners[corner]];
+            if (cell.outIdx == UNUSED)
+            {
+                // representative vertex at the optimal position, fall back to the mean if it leaves the cell
+                glm::dvec3 mean = cell.positionSum / static_cast<double>(cell.numVertices);
+                glm::dvec3 optimal;
+                if (SolveClusterQuadric(cell.quadric, optimal))
+                {
+                    unsigned long long key = cellKeys[corners[corner]];
+                    glm::dvec3 cellMin = glm::dvec3(boxMin) + glm::dvec3(
+                        static_cast<double>(key % gridDims.x),
+                        static_cast<double>((key / gridDims.x) % gridDims.y),
+                        static_cast<double>(key / (static_cast<unsigned long long>(gridDims.x) * gridDims.y))
+                    ) * static_cast<double>(cellSize);
+                    glm::dvec3 slack{ 0.5 * cellSize };
+                    if (glm::any(glm::lessThan(optimal, cellMin - slack)) ||
+                        glm::any(glm::greaterThan(optimal, cellMin + static_cast<double>(cellSize) + slack)))
+                    {
+                        optimal = mean;
+                    }
+                }
+                else
+                {
+                    optimal = mean;
+                }
+
+                cell.outIdx = static_cast<unsigned int>(VertexPos.size());
+                VertexPos.push_back(glm::vec3(optimal));
+            }
+            triangle[corner] = cell.outIdx;
+        }
+
+        // rotate the smallest index first so duplicates with the same orientation compare equal
+        while (triangle[0] > triangle[1] || triangle[0] > triangle[2])
+        {
+            triangle = glm::uvec3{ triangle[1], triangle[2], triangle[0] };
+        }
+        triangles.push_back(triangle);
+    }
+
+    // drop duplicated triangles
+    std::sort(triangles.begin(), triangles.end(), [](const glm::uvec3& a, const glm::uvec3& b)
+        {
+            return std::lexicographical_compare(&a[0], &a[0] + 3, &b[0], &b[0] + 3);
+        });
+    triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+    std::vector<std::vector<unsigned int>> FaceIndices(triangles.size());
+    for (unsigned int i = 0; i < triangles.size(); i++)
+    {
+        FaceIndices[i] = { triangles[i][0], triangles[i][1], triangles[i][2] };
+    }
+
+    // build object
+    Object Obj;
+    Obj.m_Min = obj.m_Min; Obj.m_Max = obj.m_Max;
+    Obj.m_VertexPos = VertexPos; Obj.m_FaceIndices = FaceIndices;
+    Obj.m_TriFaceIndices = FaceIndices;
+    if (!FaceIndices.empty())
+        Obj.m_NumPolygons[3] = static_cast<unsigned int>(FaceIndices.size());
+
+    return Obj;
+}
+
+Object VertexClusteringToCount(const Object& obj, unsigned int desiredCount, Progress* progress)
+{
+    // triangle count grows with the square of the resolution on a surface,
+    // so a coarse probe predicts the resolution, refined at most twice
+    unsigned int resolution = 32;
+    Object simplified = VertexClustering(obj, resolution, progress);
+    for (unsigned int attempt = 0; attempt < 3; attempt++)
+    {
+        unsigned int count = static_cast<unsigned int>(simplified.m_TriFaceIndices.size());
+        if (count == 0 || std::abs(static_cast<double>(count) - desiredCount) < 0.05 * desiredCount)
+            break;
+
+        double scale = std::sqrt(static_cast<double>(desiredCount) / count);
+        unsigned int nextResolution = static_cast<unsigned int>(std::clamp(resolution * scale, 2.0, 4096.0));
+        if (nextResolution == resolution)
+            break;
+
+        resolution = nextResolution;
+        simplified = VertexClustering(obj, resolution, progress);
+    }
+
+    return simplified;
+}
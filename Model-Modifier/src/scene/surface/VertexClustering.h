@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "../../external/glm/ext/vector_float3.hpp"
+#include "../../external/glm/ext/vector_double3.hpp"
+#include "../../external/glm/ext/vector_uint3.hpp"
+#include "../../external/glm/common.hpp"
+#include "../../external/glm/geometric.hpp"
+#include "../../external/glm/vector_relational.hpp"
+
+#include "../object/Object.h"
+#include "../util/Progress.h"
+
+// Lindstrom vertex clustering, works directly on the triangles of an Object so large inputs
+// never need the adjacency records of Surface, the working set only grows with the number of occupied cells
+struct ClusterCell
+{
+	double quadric[10]; // symmetric 4x4 quadric, upper triangle
+	glm::dvec3 positionSum;
+	unsigned int numVertices;
+	unsigned int outIdx;
+};
+
+// simplify obj on a uniform grid with gridResolution cells along its longest side
+// progress is polled by every pass, an empty object is returned once cancelled
+Object VertexClustering(const Object& obj, unsigned int gridResolution, Progress* progress = nullptr);
+// pick the grid resolution that lands close to desiredCount triangles
+Object VertexClusteringToCount(const Object& obj, unsigned int desiredCount, Progress* progress = nullptr);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// lock-free queue with any number of producers and a single consumer
+// producers push onto an atomic list, the consumer takes the whole list at once and restores the push order
+template <typename T>
+class MPSCQueue
+{
+public:
+	MPSCQueue()
+		: m_Head(nullptr)
+	{
+	}
+
+	~MPSCQueue()
+	{
+		PopAll();
+	}
+
+	MPSCQueue(const MPSCQueue&) = delete;
+	MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+	void Push(T value)
+	{
+		Node* node = new Node{ std::move(value), m_Head.load(std::memory_order_relaxed) };
+		while (!m_Head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	// everything pushed so far, oldest first
+	std::vector<T> PopAll()
+	{
+		// the list is detached whole, so no node can be popped twice
+		Node* node = m_Head.exchange(nullptr, std::memory_order_acquire);
+
+		std::vector<T> values;
+		while (node)
+		{
+			Node* next = node->next;
+			values.push_back(std::move(node->value));
+			delete node;
+			node = next;
+		}
+		std::reverse(values.begin(), values.end());
+		return values;
+	}
+
+	bool Empty() const
+	{
+		return m_Head.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+	struct Node
+	{
+		T value;
+		Node* next;
+	};
+
+	std::atomic<Node*> m_Head;
+};
@@ -0,0 +1,32 @@
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+
+void parallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int)>& body)
+{
+    // small ranges are not worth a thread launch
+    const unsigned int MIN_CHUNK = 1024;
+    unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, (count + MIN_CHUNK - 1) / MIN_CHUNK);
+    if (numThreads <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    unsigned int chunk = (count + numThreads - 1) / numThreads;
+    std::vector<std::thread> workers;
+    for (unsigned int begin = chunk; begin < count; begin += chunk)
+    {
+        workers.emplace_back(body, begin, std::min(begin + chunk, count));
+    }
+    body(0, std::min(chunk, count)); // the calling thread takes the first range
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <functional>
+
+
+// split [0, count) into contiguous ranges run on all hardware threads, body(begin, end) must not write shared data
+void parallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int)>& body);
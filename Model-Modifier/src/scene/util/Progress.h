@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+// progress and cancellation of a long running operation, shared with the thread watching it
+// the operation polls IsCancelled() and returns early with an empty result, nothing it built is kept
+// an operation runs through stages, each one counting its own work items
+class Progress
+{
+public:
+	Progress()
+		: m_Cancelled(false), m_Stage(nullptr), m_Done(0), m_Total(0)
+	{
+	}
+
+	Progress(const Progress&) = delete;
+	Progress& operator=(const Progress&) = delete;
+
+	void Cancel()
+	{
+		m_Cancelled.store(true, std::memory_order_relaxed);
+	}
+
+	bool IsCancelled() const
+	{
+		return m_Cancelled.load(std::memory_order_relaxed);
+	}
+
+	// stage must be a string literal, the watching thread reads it at any time
+	void BeginStage(const char* stage, unsigned int total)
+	{
+		m_Done.store(0, std::memory_order_relaxed);
+		m_Total.store(total, std::memory_order_relaxed);
+		m_Stage.store(stage, std::memory_order_relaxed);
+	}
+
+	void Report(unsigned int done)
+	{
+		m_Done.store(done, std::memory_order_relaxed);
+	}
+
+	// fraction of the current stage, negative while no stage reported a total
+	float GetFraction() const
+	{
+		unsigned int total = m_Total.load(std::memory_order_relaxed);
+		if (total == 0)
+			return -1.0f;
+		unsigned int done = m_Done.load(std::memory_order_relaxed);
+		return done >= total ? 1.0f : static_cast<float>(done) / total;
+	}
+
+	// name of the current stage, nullptr before the first one
+	const char* GetStage() const
+	{
+		return m_Stage.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<bool> m_Cancelled;
+	std::atomic<const char*> m_Stage;
+	std::atomic<unsigned int> m_Done;
+	std::atomic<unsigned int> m_Total;
+};
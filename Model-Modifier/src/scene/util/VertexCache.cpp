@@ -0,0 +1,154 @@
+#include "VertexCache.h"
+
+#include <algorithm>
+
+
+std::vector<unsigned int> OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize)
+{
+    unsigned int numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return {};
+
+    // vertex-triangle adjacency in CSR form, live counts are the triangles left to emit around each vertex
+    std::vector<unsigned int> liveCount(numVertices, 0);
+    for (unsigned int i = 0; i < 3 * numTriangles; i++)
+    {
+        liveCount[indices[i]]++;
+    }
+    std::vector<unsigned int> offsets(numVertices + 1, 0);
+    for (unsigned int i = 0; i < numVertices; i++)
+    {
+        offsets[i + 1] = offsets[i] + liveCount[i];
+    }
+    std::vector<unsigned int> adjTriangles(3 * numTriangles);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (unsigned int i = 0; i < 3 * numTriangles; i++)
+    {
+        adjTriangles[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<unsigned int> cacheTime(numVertices, 0);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    order.reserve(numTriangles);
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanVertex = 0;
+    while (fanVertex >= 0)
+    {
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (unsigned int k = offsets[fanVertex]; k < offsets[fanVertex + 1]; k++)
+        {
+            unsigned int triangle = adjTriangles[k];
+            if (emitted[triangle])
+                continue;
+
+            for (unsigned int corner = 0; corner < 3; corner++)
+            {
+                unsigned int vertex = indices[3 * triangle + corner];
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveCount[vertex]--;
+                if (time - cacheTime[vertex] > cacheSize)
+                    cacheTime[vertex] = time++;
+            }
+            emitted[triangle] = true;
+            order.push_back(triangle);
+        }
+
+        // next fan: the candidate still in cache after its own triangles are emitted, oldest first,
+        // candidates that would be evicted score 0 and are left to the dead-end stack
+        fanVertex = -1;
+        int bestPriority = 0;
+        for (unsigned int vertex : candidates)
+        {
+            if (liveCount[vertex] == 0)
+                continue;
+
+            int priority = 0;
+            if (time - cacheTime[vertex] + 2 * liveCount[vertex] <= cacheSize)
+                priority = static_cast<int>(time - cacheTime[vertex]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fanVertex = static_cast<int>(vertex);
+            }
+        }
+
+        // dead end: go back to a recently used vertex, then to the next one in input order
+        while (fanVertex < 0 && !deadEnds.empty())
+        {
+            unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveCount[vertex] > 0)
+                fanVertex = static_cast<int>(vertex);
+        }
+        while (fanVertex < 0 && cursor < numVertices)
+        {
+            if (liveCount[cursor] > 0)
+                fanVertex = static_cast<int>(cursor);
+            cursor++;
+        }
+    }
+
+    std::vector<unsigned int> reordered(3 * numTriangles);
+    for (unsigned int i = 0; i < numTriangles; i++)
+    {
+        for (unsigned int corner = 0; corner < 3; corner++)
+        {
+            reordered[3 * i + corner] = indices[3 * order[i] + corner];
+        }
+    }
+    std::copy(reordered.begin(), reordered.end(), indices);
+
+    return order;
+}
+
+std::vector<unsigned int> OptimizeVertexFetch(unsigned int* indices, unsigned int numIndices, unsigned int numVertices)
+{
+    const unsigned int UNUSED = 0xFFFFFFFF;
+    std::vector<unsigned int> remap(numVertices, UNUSED);
+
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < numIndices; i++)
+    {
+        if (remap[indices[i]] == UNUSED)
+            remap[indices[i]] = next++;
+        indices[i] = remap[indices[i]];
+    }
+    for (unsigned int i = 0; i < numVertices; i++)
+    {
+        if (remap[i] == UNUSED)
+            remap[i] = next++;
+    }
+
+    return remap;
+}
+
+float ComputeACMR(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize)
+{
+    unsigned int numTriangles = numIndices / 3;
+    if (numTriangles == 0)
+        return 0.0f;
+
+    // FIFO cache: a vertex is a hit while fewer than cacheSize misses happened since it was loaded
+    std::vector<unsigned int> loadedAt(numVertices, 0);
+    std::vector<bool> loaded(numVertices, false);
+    unsigned int misses = 0;
+    for (unsigned int i = 0; i < 3 * numTriangles; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (!loaded[vertex] || misses - loadedAt[vertex] >= cacheSize)
+        {
+            loaded[vertex] = true;
+            loadedAt[vertex] = misses;
+            misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / numTriangles;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+
+// post-transform vertex cache size assumed by the optimization and the statistics
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// reorder the triangles for the post-transform cache (Tipsify, Sander et al. 2007), corners keep their order
+// returns the input triangle of every output triangle
+std::vector<unsigned int> OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// number vertices by first use so fetches walk the vertex buffer forward, unused vertices go last
+// returns the new index of every vertex, the indices are remapped in place
+std::vector<unsigned int> OptimizeVertexFetch(unsigned int* indices, unsigned int numIndices, unsigned int numVertices);
+
+// average cache miss ratio, vertex shader runs per triangle of a FIFO cache
+float ComputeACMR(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize = VERTEX_CACHE_SIZE);